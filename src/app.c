@@ -1,3 +1,4 @@
+#include <time.h>
 #include "app.h"
 #include "glfw/callbacks.h"
 #include "glfw/inputstates.h"
@@ -41,39 +42,107 @@ void app_update (App * app)
         app->paused = !app->paused;
         //printf("Emulator %s\n", app->paused ? "paused" : "running");
     }
-    if (input_new_key (key, lastKey, input->EMULATION_DEBUG))  ppu_toggle_debug (&NES.ppu);
-    if (input_new_key (key, lastKey, input->EMULATION_RESET))  bus_reset (&NES);
+    if (input_new_key (key, lastKey, input->EMULATION_DEBUG))  ppu_toggle_debug (&app->bus->ppu);
+    if (input_new_key (key, lastKey, input->EMULATION_RECORD))   app_toggle_record (app);
+    if (input_new_key (key, lastKey, input->EMULATION_PLAY))     app_toggle_playback (app);
+    if (input_new_key (key, lastKey, input->EMULATION_RESET))
+    {
+        /* Resets are part of a recording, and come from the movie during playback */
+        if (app->movie.mode == MOVIE_RECORD) movie_record_reset (&app->movie, app->bus);
+        if (app->movie.mode == MOVIE_IDLE)   nesemu_reset (app->bus);
+    }
+    if (input_new_key (key, lastKey, input->EMULATION_RUN_AHEAD)) app_change_run_ahead (app);
 
     /* Controller buttons */
-    NES.controller[0] = app_controller_state (key, input);
+    nesemu_set_input (app->bus, 0, app_controller_state (key, input));
 
-    /* Update emulator in real time or step through cycles */
+    /* Update emulator in real time, rewind or step through cycles */
     if (!app->paused) {
-        bus_exec (&NES, 29829);
+        if (input_key (key, input->EMULATION_REWIND) && app->movie.mode == MOVIE_IDLE) {
+            /* Show each snapshot for as many frames as were played after it */
+            if (!app->rewindDelay && rewind_pop (&app->rewind, app->bus)) {
+                nesemu_run_frame (app->bus);
+                app->rewindDelay = app->rewind.interval;
+            }
+            if (app->rewindDelay) app->rewindDelay--;
+        }
+        else {
+            /* Movie playback replaces the controllers, recording logs them */
+            if (app->movie.mode == MOVIE_PLAY && !movie_play_frame (&app->movie, app->bus))
+                printf("Movie playback ended\n");
+            movie_record_frame (&app->movie, app->bus);
+
+            /* With run-ahead only the last frame run ahead is shown */
+            app->bus->ppu.suppressVideo = (app->runAhead > 0);
+            nesemu_run_frame (app->bus);
+            rewind_push (&app->rewind, app->bus);
+            app->rewindDelay = 0;
+            app_run_ahead (app);
+        }
     }
     else {
-        if (input_key     (key,          input->EMULATION_SCANLINE)) { bus_scanline_step (&NES); }
-        if (input_new_key (key, lastKey, input->EMULATION_STEP))     { bus_cpu_tick (&NES); }
+        if (input_key     (key,          input->EMULATION_SCANLINE)) { bus_scanline_step (app->bus); }
+        if (input_new_key (key, lastKey, input->EMULATION_STEP))     { bus_cpu_tick (app->bus); }
     }
 
     /* Update window title */
     char textbuf[256];
-    snprintf(textbuf, sizeof(textbuf), "NES emulator | Frame time: %.3f ms | %s", app->timer.frameTime, NES.rom.filename);
+    snprintf(textbuf, sizeof(textbuf), "NES emulator | Frame time: %.3f ms | Run-ahead: %d | Rewind: %.2f MB/min | %s%s", 
+        app->timer.frameTime, app->runAhead, rewind_bytes_per_minute (&app->rewind) / (1 << 20), 
+        (app->movie.mode == MOVIE_RECORD) ? "[REC] " : (app->movie.mode == MOVIE_PLAY) ? "[PLAY] " : "", app->bus->rom.filename);
     update_timer (&app->timer, glfwGetTime());
 
     glfwSetWindowTitle(app->window, textbuf);
     glfwPollEvents();
 }
 
+/* Run-ahead. The frame just emulated is saved, then the following frames are
+   run with the same input and only the last one is drawn. Loading the state
+   back leaves that frame on screen, so the picture reacts to input runAhead
+   frames sooner. The real frame and the extra frames skip drawing, see
+   ppu_render_line */
+
+void app_run_ahead (App * const app)
+{
+    if (!app->runAhead)
+        return;
+
+    const size_t size = nesemu_state_size (app->bus);
+    if (size > app->runAheadSize)
+    {
+        free (app->runAheadState);
+        app->runAheadState = malloc (size);
+        app->runAheadSize  = app->runAheadState ? size : 0;
+
+        /* The real frame was not drawn, turn run-ahead off from the next one */
+        if (!app->runAheadState)
+        {
+            printf("Run-ahead disabled, no memory for its state\n");
+            app->runAhead = 0;
+            return;
+        }
+    }
+    nesemu_save_state (app->bus, app->runAheadState);
+
+    app->bus->ppu.suppressVideo = 1;
+    for (uint8_t i = 1; i < app->runAhead; i++)
+        nesemu_run_frame (app->bus);
+
+    app->bus->ppu.suppressVideo = 0;
+    nesemu_run_frame (app->bus);
+
+    nesemu_load_state (app->bus, app->runAheadState, size);
+}
+
 void app_draw (App * const app)
 {
     glfwMakeContextCurrent (app->window);
-    draw_scene (app->window, &app->scene);
+    draw_scene (app->window, &app->scene, app->bus);
     glfwSwapBuffers(app->window);
 /* 
 #ifdef PPU_DEBUG    
     glfwMakeContextCurrent (app->debugWindow);
-    draw_ntable_debug (app->debugWindow, &app->scene);
+    draw_ntable_debug (app->debugWindow, &app->scene, &app->bus->ppu);
     glfwSwapBuffers(app->debugWindow);
 #endif
 */
@@ -92,8 +161,11 @@ void app_capture_drop (App * app, char * paths[])
     app->dropPath = paths[0];
 
     /* Attempt to load the file */
-    if (rom_load (&NES, app->dropPath))
+    if (nesemu_load_file (app->bus, app->dropPath)) {
+        rewind_clear (&app->rewind);
+        movie_stop (&app->movie);
         app->paused = 0;
+    }
 }
 
 void app_open_dialog (App * const app)
@@ -103,9 +175,65 @@ void app_open_dialog (App * const app)
 
     if (result == NFD_OKAY) 
     {
-        if (rom_load (&NES, outPath)) 
+        if (nesemu_load_file (app->bus, outPath)) {
+            rewind_clear (&app->rewind);
+            movie_stop (&app->movie);
             app->paused = 0;
+        }
+    }
+}
+
+/* Movies are kept next to the working directory, named after the ROM */
+
+static void app_movie_path (App * const app, char * const path, size_t const size)
+{
+    snprintf(path, size, "%s.nsmv", app->bus->rom.filename);
+}
+
+void app_toggle_record (App * const app)
+{
+    char path[160];
+    app_movie_path (app, path, sizeof(path));
+
+    if (app->movie.mode == MOVIE_RECORD)
+    {
+        movie_stop (&app->movie);
+        printf("Movie %s (%u frames)\n", movie_save (&app->movie, path) ? "saved to" : "could not be saved to", app->movie.frames);
+        printf("%s\n", path);
+        return;
+    }
+
+    /* Recording starts from power on, the history before it no longer applies */
+    movie_record_start (&app->movie, app->bus, (uint32_t)time(NULL));
+    rewind_clear (&app->rewind);
+    printf("Recording movie\n");
+}
+
+void app_toggle_playback (App * const app)
+{
+    char path[160];
+    app_movie_path (app, path, sizeof(path));
+
+    if (app->movie.mode != MOVIE_IDLE)
+    {
+        movie_stop (&app->movie);
+        printf("Movie stopped\n");
+        return;
     }
+
+    if (!movie_load_file (&app->movie, path) || !movie_play_start (&app->movie, app->bus))
+    {
+        printf("No movie for this ROM at %s\n", path);
+        return;
+    }
+    rewind_clear (&app->rewind);
+    printf("Playing movie (%u frames)\n", app->movie.frames);
+}
+
+void app_change_run_ahead (App * const app)
+{
+    app->runAhead = (app->runAhead >= 3) ? 0 : app->runAhead + 1;
+    printf("Run-ahead set to %d frame(s) \n", app->runAhead);
 }
 
 void app_change_scale (App * const app)
@@ -2,6 +2,8 @@
 #include "timer.h"
 #include "glfw/callbacks.h"
 #include "glfw/inputstates.h"
+#include "rewind.h"
+#include "movie.h"
 
 typedef void (*appEventPtr)();
 
@@ -19,6 +21,10 @@ typedef struct App_struct
             EMULATION_SCANLINE,
             EMULATION_DEBUG,
             EMULATION_RESET,
+            EMULATION_REWIND,
+            EMULATION_RUN_AHEAD,
+            EMULATION_RECORD,
+            EMULATION_PLAY,
             BUTTON_A,
             BUTTON_B,
             BUTTON_SELECT,
@@ -49,10 +55,23 @@ typedef struct App_struct
     uint8_t  paused;
     uint8_t  ppuDebug;
     uint8_t  screenScale;
+    uint16_t rewindDelay;
+    uint8_t  runAhead;
 
     /* App assets */
     Scene scene;
     Timer timer;
+
+    /* Emulated console */
+    Bus * bus;
+    Rewind rewind;
+
+    /* Input movie being recorded or played */
+    Movie movie;
+
+    /* Snapshot to return to after running ahead */
+    uint8_t * runAheadState;
+    size_t    runAheadSize;
 }
 App;
 
@@ -63,6 +82,9 @@ void app_capture_mouse_scroll (App * const, double xOffset, double yOffset);
 void app_capture_drop         (App * const, char * paths[]);
 void app_open_dialog          (App * const);
 void app_change_scale         (App * const);
+void app_change_run_ahead     (App * const);
+void app_toggle_record        (App * const);
+void app_toggle_playback      (App * const);
 
 void app_init         (App *);
 void app_free         (App *);
@@ -70,6 +92,7 @@ void app_free         (App *);
 void app_init_inputs  (App *);
 void app_handle_input (App *);
 void app_update       (App *);
+void app_run_ahead    (App *);
 void app_draw         (App *);
 
 uint8_t app_controller_state (KeyboardState * const, struct appInputs * const);
\ No newline at end of file
@@ -2,6 +2,7 @@
 #define BUS_H
 
 #include <stdio.h>
+#include <stddef.h>
 #include <stdint.h>
 #include "cpu6502.h"
 #include "ppu2c02.h"
@@ -10,78 +11,132 @@
 
 typedef struct Bus_struct 
 {
-    /* Bus components */
-    uint8_t  ram[2 * 1024];
+    /* Master clock, in CPU cycles. Holds the start cycle of the running instruction */
+    uint64_t clockCount;
+
+    /* Bus components. The CPU's hot state shares the first cache line with the clock */
     CPU6502  cpu;
-    PPU2C02  ppu;
-    NESrom   rom;
 
     /* Controllers */
     uint8_t controller[2];
     uint8_t controllerState[2];
 
-    /* Master clock */
-    uint64_t clockCount;
+    /* IRQ line, one bit per source. The CPU samples it between instructions */
+    uint8_t irq;
+
+    /* CPU page tables, one direct pointer per 256 byte page. Pages left NULL
+       (I/O and unmapped cartridge space) go through the address decoder */
+    uint8_t *readMap[256];
+    uint8_t *writeMap[256];
+
+    uint8_t  ram[2 * 1024];
+    PPU2C02  ppu;
+    NESrom   rom;
 }
 Bus;
 
-extern Bus NES;
-extern CPU6502 *cpu;
+/* Layout checks, run `make layout` for the full report */
 
-inline void bus_reset (Bus * const bus)
+_Static_assert (offsetof(Bus, cpu) + offsetof(CPU6502, clockGoal) + sizeof(uint64_t) <= 64,
+    "Bus clock and CPU hot state should fit in one cache line");
+_Static_assert (offsetof(PPU2C02, paletteTable) + sizeof(((PPU2C02*)0)->paletteTable) <= 128,
+    "PPU hot state should fit in two cache lines");
+
+/* Point system RAM and its mirrors into the page tables, then let the mapper
+   fill in its PRG banks */
+
+inline void bus_map_reset (Bus * const bus)
 {
-    bus->clockCount = 0;
+    for (int page = 0; page < 256; page++)
+    {
+        bus->readMap[page] = bus->writeMap[page] = NULL;
+    }
+    for (int page = 0; page < 0x20; page++)
+    {
+        bus->readMap[page] = bus->writeMap[page] = &bus->ram[(page & 7) << 8];
+    }
 
+    bus->rom.mapper.pageMap  = bus->readMap;
+    bus->rom.mapper.writeMap = bus->writeMap;
+    bus->rom.mapper.IRQline  = &bus->irq;
+    bus->irq &= ~IRQ_MAPPER;
+    if (bus->rom.mapper.map)
+    {
+        bus->rom.mapper.map (&bus->rom.mapper);
+    }
+}
+
+inline void bus_reset (Bus * const bus)
+{
+    bus_map_reset (bus);
     ppu_reset (&bus->ppu, &bus->rom);
-    cpu_reset (&bus->cpu);
-    printf("Program counter set to %x \n", bus->cpu.r.pc);
+    cpu_reset (bus);
+
+    /* The reset sequence takes its cycles before the first fetch */
+    bus->clockCount = bus->cpu.clockticks;
+    bus->cpu.clockGoal = 0;
 }
 
-inline void bus_exec (Bus * const bus, uint32_t const tickcount)
+/* Catch-up scheduler: the CPU runs whole instructions and the PPU is only
+   brought up to the CPU's time when the CPU touches it, when an NMI may be
+   due (see eventClock), or when a run of cycles ends. Accesses made by an
+   instruction see the PPU as it is one CPU cycle after the instruction starts */
+
+inline void bus_sync (Bus * const bus, uint64_t const clock)
 {
-    bus->cpu.clockGoal += tickcount;
-    bus->ppu.clockGoal += tickcount * 3;
+    uint64_t const dots = clock * 3;
 
-    uint32_t ticks = tickcount;
+    if (bus->ppu.clockCount < dots)
+        ppu_exec (&bus->ppu, dots - bus->ppu.clockCount);
+}
 
-    while (--ticks)
-    {
-        ++bus->clockCount;
+inline void bus_step (Bus * const bus)
+{
+    /* Catch up first if vertical blank (and an NMI) or a mapper IRQ clock falls before this instruction */
+    if ((bus->clockCount + 1) * 3 >= bus->ppu.eventClock)
+        bus_sync (bus, bus->clockCount + 1);
 
-        ppu_clock (&bus->ppu);
-        ppu_clock (&bus->ppu);
-        ppu_clock (&bus->ppu);
+    bus->clockCount += cpu_clock (bus);
+}
 
-        cpu_clock (bus);
-    }
+inline void bus_exec (Bus * const bus, uint32_t const tickcount)
+{
+    bus->cpu.clockGoal += tickcount;
+
+    while (bus->clockCount < bus->cpu.clockGoal)
+        bus_step (bus);
+
+    /* End of the run, let the PPU finish the frame */
+    bus_sync (bus, bus->cpu.clockGoal);
 }
 
 /* Run one instruction from the CPU */
 
 inline void bus_cpu_tick (Bus * const bus)
 {
-    bus_exec (bus, bus->cpu.clockticks + 1);
+    bus_step (bus);
+    bus->cpu.clockGoal = bus->clockCount;
+    bus_sync (bus, bus->clockCount);
 }
 
 /* Run one scanline */
 
 inline void bus_scanline_step (Bus * const bus)
 {
-    bus->ppu.clockGoal += 341;
-
-    while (bus->ppu.clockCount < bus->ppu.clockGoal)
-    {
-        if (bus->clockCount++ % 3 == 0)
-            cpu_clock (bus);
-
-        ppu_clock (&bus->ppu);
-    }
+    bus_exec (bus, 341 / 3);
 }
 
 inline uint8_t bus_read (Bus * const bus, uint16_t const address) 
 {
     uint8_t data = 0;
 
+    /* RAM and PRG fetches are a single table lookup */
+    uint8_t * const page = bus->readMap[address >> 8];
+    if (page)
+    {
+        return page[address & 0xff];
+    }
+
     /* Read from system ram 8kB range, fetch 2kB mirror */
     if (address >= 0 && address < 0x2000)
     {
@@ -91,6 +146,7 @@ inline uint8_t bus_read (Bus * const bus, uint16_t const address)
 	/* Read from PPU, mirrored every 8 bytes */
     else if (address >= 0x2000 && address < 0x4000)
 	{
+        bus_sync (bus, bus->clockCount + 1);
         /* printf("Attempting to read from PPU at register %x, pc:%04x data:%02x\n", address & 0x7, bus->cpu.lastpc, data); */
 		data = ppu_register_read (&bus->ppu, address & 0x7);
 	}
@@ -110,7 +166,7 @@ inline uint8_t bus_read (Bus * const bus, uint16_t const address)
     {
         if (bus->rom.mapper.read)
         {
-            data = bus->rom.mapper.read (&bus->rom.mapper, address, 0);
+            data = bus->rom.mapper.read (&bus->rom.mapper, address);
         }
     }
     
@@ -119,6 +175,13 @@ inline uint8_t bus_read (Bus * const bus, uint16_t const address)
 
 inline void bus_write (Bus * const bus, uint16_t const address, uint8_t const data) 
 {
+    uint8_t * const page = bus->writeMap[address >> 8];
+    if (page)
+    {
+        page[address & 0xff] = data;
+        return;
+    }
+
     /* Read from system ram 8kB range, write to 2kB mirror */
 	if (address >= 0 && address < 0x2000)
     {
@@ -128,12 +191,14 @@ inline void bus_write (Bus * const bus, uint16_t const address, uint8_t const da
 	else if (address >= 0x2000 && address <= 0x3fff)
 	{
         //printf("Attempting to write to PPU at register %x, pc:%04x data:%02x\n", address & 0x7, bus->cpu.lastpc, data);
+        bus_sync (bus, bus->clockCount + 1);
 		ppu_register_write (&bus->ppu, address & 0x7, data);
 	}
     /* Write to OAM DMA register */
     else if (address == 0x4014)
     { 
         uint16_t DMApage = (uint16_t)data << 8;
+        bus_sync (bus, bus->clockCount + 1);
 
         for (int i = 0; i < 256; i++) 
         {
@@ -144,12 +209,19 @@ inline void bus_write (Bus * const bus, uint16_t const address, uint8_t const da
     {
         bus->controllerState[address & 1] = bus->controller[address & 1];
     }
-    /* Write to cartridge */
+    /* Write to cartridge, bank switches may change what the PPU sees */
     else if (address >= 0x8000 && address <= 0xffff)
     {
         if (bus->rom.mapper.write)
         {
-            bus->rom.mapper.write (&bus->rom.mapper, address, data, 0);
+            bus_sync (bus, bus->clockCount + 1);
+            bus->rom.mapper.write (&bus->rom.mapper, address, data);
+
+            /* Some mappers switch nametable mirroring or their IRQ counter */
+            if (bus->rom.mapper.mirroring != bus->ppu.mirroring)
+                ppu_set_mirroring (&bus->ppu, bus->rom.mapper.mirroring);
+            if (bus->rom.mapper.scanline)
+                ppu_schedule (&bus->ppu);
         }
     }
 }
@@ -5,13 +5,29 @@
 #include <string.h>
 #include "bus.h"
 
-/* externally supplied functions and defines */
+/* externally supplied functions and defines. Every handler gets the bus it
+   runs on, and cpu names that bus's processor */
 
-uint8_t cpu_read (uint16_t address)                { return bus_read(&NES, address);  }
-void    cpu_write(uint16_t address, uint8_t value) { bus_write(&NES, address, value); }
+#define cpu (&bus->cpu)
 
-Bus NES;
-CPU6502 *cpu = &NES.cpu;
+/* External definitions of the bus accessors, for call sites the compiler doesn't inline */
+
+extern inline uint8_t bus_read  (Bus * const bus, uint16_t const address);
+extern inline void    bus_write (Bus * const bus, uint16_t const address, uint8_t const data);
+extern inline void    bus_sync  (Bus * const bus, uint64_t const clock);
+
+/* Mapped pages are read in place, everything else goes through the bus */
+
+static inline uint8_t cpu_read (Bus * const bus, uint16_t const address)
+{
+    uint8_t * const page = bus->readMap[address >> 8];
+    return page ? page[address & 0xff] : bus_read (bus, address);
+}
+
+static inline void cpu_write (Bus * const bus, uint16_t const address, uint8_t const value)
+{
+    bus_write (bus, address, value);
+}
 
 #define saveaccum(n) cpu->r.a = (uint8_t)((n) & 0xff)
 
@@ -75,9 +91,12 @@ CPU6502 *cpu = &NES.cpu;
 /* Forward declare the op table */
 
 struct  Instruction optable[256];
-uint8_t penaltyop, penaltyaddr;
 
-void cpu_reset (CPU6502 * const cpu) 
+#ifndef CPU_TABLE_CORE
+static uint8_t cpu_execute (Bus * const bus, uint8_t const opcode);
+#endif
+
+void cpu_reset (Bus * const bus) 
 {
     cpu->abs_addr = 0xfffc;
     cpu->clockCount = 0;
@@ -87,144 +106,151 @@ void cpu_reset (CPU6502 * const cpu)
 	cpu->r.status = FLAG_CONSTANT | FLAG_INTERRUPT;
 
 	/* Reset PC vector */
-    cpu->r.pc = cpu_read(0xfffc) | (cpu_read(0xfffd) << 8);
+    cpu->r.pc = cpu_read(bus, 0xfffc) | (cpu_read(bus, 0xfffd) << 8);
 
 	/* Takes 7 cycles to reset */
     cpu->clockticks = 7;
 }
 
-void cpu_clock (Bus * const bus)
+uint8_t cpu_clock (Bus * const bus)
 {
-    /* If NMI flag has been set, handle the interrupt */
+    /* If NMI flag has been set, handle the interrupt at the instruction boundary */
     if (bus->ppu.nmi)
     {
-        nmi();
+        nmi (bus);
         bus->ppu.nmi = 0;
-        cpu->clockCount += 8;
-        cpu->clockticks = 0;
     }
-
-    if (cpu->clockticks == 0)
+    /* IRQ is level triggered, taken while the line is held and not masked */
+    else if (bus->irq && !(cpu->r.status & FLAG_INTERRUPT))
     {
-        cpu->opcode = cpu_read(cpu->r.pc++);
-        
+        irq (bus);
+    }
+    else
+    {
+        cpu->opcode = cpu_read(bus, cpu->r.pc++);
+#ifdef CPU_TABLE_CORE
         /* Fetch OP name, convert op position from table into ID */
         cpu->opID = ((cpu->opcode & 3) * 0x40) + (cpu->opcode >> 2);
 
         /* Exec instruction and get no. of cycles */
-        penaltyop = 0;
+        cpu->penaltyop = 0;
         cpu->clockticks = optable[cpu->opID].ticks;
 
-        penaltyaddr = (*optable[cpu->opID].addrmode)();
-        (*optable[cpu->opID].op)();
+        cpu->penaltyaddr = (*optable[cpu->opID].addrmode)(bus);
+        (*optable[cpu->opID].op)(bus);
 
-        if (penaltyop && penaltyaddr) cpu->clockticks++;
+        if (cpu->penaltyop && cpu->penaltyaddr) cpu->clockticks++;
+#else
+        /* Exec instruction through the single dispatch site */
+        cpu->clockticks = cpu_execute (bus, cpu->opcode);
+#endif
 
         /* Reset the unused flag */
         cpu->instructions++;
     }
-    cpu->clockticks--;
-    cpu->clockCount++;
+    cpu->clockCount += cpu->clockticks;
+
+    return cpu->clockticks;
 }
 
 //a few general functions used by various other functions
-void push16 (uint16_t pushval)
+void push16 (Bus * const bus, uint16_t pushval)
 {
-    cpu_write (BASE_STACK + cpu->r.sp--, (pushval >> 8) & 0xff);
-    cpu_write (BASE_STACK + cpu->r.sp--, pushval & 0xff);
+    cpu_write (bus, BASE_STACK + cpu->r.sp--, (pushval >> 8) & 0xff);
+    cpu_write (bus, BASE_STACK + cpu->r.sp--, pushval & 0xff);
 }
 
-void push8 (uint8_t pushval) 
+void push8 (Bus * const bus, uint8_t pushval) 
 {
-    cpu_write (BASE_STACK + cpu->r.sp--, pushval);
+    cpu_write (bus, BASE_STACK + cpu->r.sp--, pushval);
 }
 
-uint16_t pull16() 
+uint16_t pull16 (Bus * const bus) 
 {
     uint16_t temp16;
-    temp16 = cpu_read (BASE_STACK + ((cpu->r.sp + 1) & 0xFF)) | ((uint16_t) cpu_read(BASE_STACK + ((cpu->r.sp + 2) & 0xFF)) << 8);
+    temp16 = cpu_read (bus, BASE_STACK + ((cpu->r.sp + 1) & 0xFF)) | ((uint16_t) cpu_read(bus, BASE_STACK + ((cpu->r.sp + 2) & 0xFF)) << 8);
     cpu->r.sp += 2;
     return(temp16);
 }
 
-uint8_t pull8() 
+uint8_t pull8 (Bus * const bus) 
 {
     cpu->r.sp++;
-    return (cpu_read (BASE_STACK + cpu->r.sp));
+    return (cpu_read (bus, BASE_STACK + cpu->r.sp));
 }
 
 /* addressing mode functions, calculates effective addresses */
 
-uint8_t acc()
+uint8_t acc (Bus * const bus)
 {
     get_addrmode();
 	cpu->value = cpu->r.a;
 	return 0;
 }
 
-uint8_t impl()
+uint8_t impl (Bus * const bus)
 {
     get_addrmode();
 	cpu->value = cpu->r.a;
 	return 0;
 }
 
-uint8_t imm()
+uint8_t imm (Bus * const bus)
 {
     get_addrmode();
 	cpu->abs_addr = cpu->r.pc++;	
 	return 0;
 }
 
-uint8_t zp()
+uint8_t zp (Bus * const bus)
 {
     get_addrmode();
-	cpu->abs_addr = cpu_read(cpu->r.pc++);
+	cpu->abs_addr = cpu_read(bus, cpu->r.pc++);
 	cpu->abs_addr &= 0xff;
 	return 0;
 }
 
-uint8_t zpx()
+uint8_t zpx (Bus * const bus)
 {
     get_addrmode();
-	cpu->abs_addr = (cpu_read(cpu->r.pc++) + cpu->r.x);
+	cpu->abs_addr = (cpu_read(bus, cpu->r.pc++) + cpu->r.x);
 	cpu->abs_addr &= 0xff;
 	return 0;
 }
 
-uint8_t zpy()
+uint8_t zpy (Bus * const bus)
 {
     get_addrmode();
-	cpu->abs_addr = (cpu_read(cpu->r.pc++) + cpu->r.y);
+	cpu->abs_addr = (cpu_read(bus, cpu->r.pc++) + cpu->r.y);
 	cpu->abs_addr &= 0xff;
 	return 0;
 }
 
-uint8_t rel()
+uint8_t rel (Bus * const bus)
 {
     get_addrmode();
-	cpu->rel_addr = cpu_read(cpu->r.pc++);
+	cpu->rel_addr = cpu_read(bus, cpu->r.pc++);
 	if (cpu->rel_addr & 0x80)
 		cpu->rel_addr |= 0xff00;
 	return 0;
 }
 
-uint8_t abso()
+uint8_t abso (Bus * const bus)
 {
     get_addrmode();
-    uint16_t lo = cpu_read(cpu->r.pc++);
-	uint16_t hi = cpu_read(cpu->r.pc++);
+    uint16_t lo = cpu_read(bus, cpu->r.pc++);
+	uint16_t hi = cpu_read(bus, cpu->r.pc++);
 
 	cpu->abs_addr = (hi << 8) | lo;
 
 	return 0;
 }
 
-uint8_t absx()
+uint8_t absx (Bus * const bus)
 {
     get_addrmode();
-    uint16_t lo = cpu_read(cpu->r.pc++);
-	uint16_t hi = cpu_read(cpu->r.pc++);
+    uint16_t lo = cpu_read(bus, cpu->r.pc++);
+	uint16_t hi = cpu_read(bus, cpu->r.pc++);
 
 	cpu->abs_addr = (hi << 8) | lo;
 	cpu->abs_addr += cpu->r.x;
@@ -235,11 +261,11 @@ uint8_t absx()
 		return 0;	
 }
 
-uint8_t absy()
+uint8_t absy (Bus * const bus)
 {
     get_addrmode();
-    uint16_t lo = cpu_read(cpu->r.pc++);
-	uint16_t hi = cpu_read(cpu->r.pc++);
+    uint16_t lo = cpu_read(bus, cpu->r.pc++);
+	uint16_t hi = cpu_read(bus, cpu->r.pc++);
 
 	cpu->abs_addr = (hi << 8) | lo;
 	cpu->abs_addr += cpu->r.y;
@@ -250,43 +276,43 @@ uint8_t absy()
 		return 0;
 }
 
-uint8_t ind() 
+uint8_t ind (Bus * const bus) 
 {
     get_addrmode();
-    uint16_t lo = cpu_read(cpu->r.pc++);
-	uint16_t hi = cpu_read(cpu->r.pc++);
+    uint16_t lo = cpu_read(bus, cpu->r.pc++);
+	uint16_t hi = cpu_read(bus, cpu->r.pc++);
 	uint16_t ptr = (hi << 8) | lo;
 
 	if (lo == 0x00ff) { /* Simulate page boundary hardware bug */
-		cpu->abs_addr = (cpu_read(ptr & 0xff00) << 8) | cpu_read(ptr + 0);
+		cpu->abs_addr = (cpu_read(bus, ptr & 0xff00) << 8) | cpu_read(bus, ptr + 0);
 	}
 	else {
-		cpu->abs_addr = (cpu_read(ptr + 1) << 8) | cpu_read(ptr + 0);
+		cpu->abs_addr = (cpu_read(bus, ptr + 1) << 8) | cpu_read(bus, ptr + 0);
     }
     return 0;
 }
 
-uint8_t idx()
+uint8_t idx (Bus * const bus)
 {
     get_addrmode();
-	uint16_t t = cpu_read(cpu->r.pc++);
+	uint16_t t = cpu_read(bus, cpu->r.pc++);
 
-	uint16_t lo = cpu_read((uint16_t)(t + (uint16_t)cpu->r.x) & 0xff);
-	uint16_t hi = cpu_read((uint16_t)(t + (uint16_t)cpu->r.x + 1) & 0xff);
+	uint16_t lo = cpu_read(bus, (uint16_t)(t + (uint16_t)cpu->r.x) & 0xff);
+	uint16_t hi = cpu_read(bus, (uint16_t)(t + (uint16_t)cpu->r.x + 1) & 0xff);
 
 	cpu->abs_addr = (hi << 8) | lo;
 	
 	return 0;
 }
 
-uint8_t idy()
+uint8_t idy (Bus * const bus)
 {
     get_addrmode();
-	uint16_t t = cpu_read(cpu->r.pc);
+	uint16_t t = cpu_read(bus, cpu->r.pc);
 	cpu->r.pc++;
 
-	uint16_t lo = cpu_read(t & 0x00ff);
-	uint16_t hi = cpu_read((t + 1) & 0x00ff);
+	uint16_t lo = cpu_read(bus, t & 0x00ff);
+	uint16_t hi = cpu_read(bus, (t + 1) & 0x00ff);
 
 	cpu->abs_addr = (hi << 8) | lo;
 	cpu->abs_addr += cpu->r.y;
@@ -297,26 +323,26 @@ uint8_t idy()
 		return 0;
 }
 
-static uint16_t getvalue() 
+static uint16_t getvalue (Bus * const bus) 
 {
     if (!(optable[cpu->opID].addrmode == acc))
-		return cpu_read (cpu->abs_addr);
+		return cpu_read (bus, cpu->abs_addr);
 
 	return cpu->value;
 }
     
-static void putvalue(uint16_t saveval) 
+static void putvalue (Bus * const bus, uint16_t saveval) 
 {
     if (optable[cpu->opID].addrmode == acc) cpu->r.a = (uint8_t)(saveval & 0xff);
-        else cpu_write (cpu->abs_addr, (saveval & 0xff));
+        else cpu_write (bus, cpu->abs_addr, (saveval & 0xff));
 }
 
 /* instruction handler functions */
 
-void adc() /* Add with carry */
+void adc (Bus * const bus) /* Add with carry */
 {
     get_opname(); 
-	cpu->value = getvalue();
+	cpu->value = getvalue(bus);
 	uint16_t result = (uint16_t) cpu->r.a + (uint16_t) cpu->value + 
         (uint16_t)(cpu->r.status & FLAG_CARRY);
 	
@@ -326,164 +352,164 @@ void adc() /* Add with carry */
     signcalc(result);
 	
 	cpu->r.a = result & 0xff;
-	penaltyop = 1;
+	cpu->penaltyop = 1;
 }
 
-void and() /* AND (with accumulator) */
+void and (Bus * const bus) /* AND (with accumulator) */
 {
     get_opname();
-    cpu->value = getvalue();
+    cpu->value = getvalue(bus);
     uint16_t result = (uint16_t) cpu->r.a & cpu->value;
 
     zerocalc(result);
     signcalc(result);
 
     saveaccum(result);
-    penaltyop = 1;
+    cpu->penaltyop = 1;
 }
 
-void asl() /* Arithmetic shift left */
+void asl (Bus * const bus) /* Arithmetic shift left */
 {
     get_opname();
-    cpu->value = getvalue();
+    cpu->value = getvalue(bus);
     uint16_t result = (uint16_t)cpu->value << 1;
 
     carrycalc(result);
     zerocalc(result);
     signcalc(result);
 
-    putvalue(result);
+    putvalue(bus, result);
 }
 
-void bcc() /* Branch on carry clear */
+void bcc (Bus * const bus) /* Branch on carry clear */
 {
     get_opname();
     if (!(cpu->r.status & FLAG_CARRY)) branch();
 }
 
-void bcs() /* Branch on carry set */
+void bcs (Bus * const bus) /* Branch on carry set */
 {
     get_opname();
     if (cpu->r.status & FLAG_CARRY) branch();
 }
 
-void beq() /* Branch if equal (zero set) */
+void beq (Bus * const bus) /* Branch if equal (zero set) */
 {
     get_opname();
     if (cpu->r.status & FLAG_ZERO) branch();
 }   
 
-void bit() /* Test bits */
+void bit (Bus * const bus) /* Test bits */
 {
     get_opname();
-    cpu->value = getvalue();
+    cpu->value = getvalue(bus);
     zerocalc((uint16_t)(cpu->r.a & cpu->value));
 
     /* sign and overflow mask */
     cpu->r.status = (cpu->r.status & 0x3f) | (uint8_t)(cpu->value & 0xc0);
 }
 
-void bmi() /* Branch on minus (sign set) */
+void bmi (Bus * const bus) /* Branch on minus (sign set) */
 {
     get_opname();
     if (cpu->r.status & FLAG_SIGN) branch();
 }
 
-void bne() /* Branch if not equal (zero clear) */
+void bne (Bus * const bus) /* Branch if not equal (zero clear) */
 {
     get_opname();
 	if (!(cpu->r.status & FLAG_ZERO)) branch();
 }
 
-void bpl() /* Branch on plus (sign clear) */
+void bpl (Bus * const bus) /* Branch on plus (sign clear) */
 {
     get_opname();
     if (!(cpu->r.status & FLAG_SIGN)) branch();
 }
 
-void brk() /* Break */
+void brk (Bus * const bus) /* Break */
 {
     get_opname();
-    push16 (++cpu->r.pc); //push next instruction address onto stack
-    push8 (cpu->r.status | FLAG_BREAK); //push CPU cpu->r.status to stack
+    push16 (bus, ++cpu->r.pc); //push next instruction address onto stack
+    push8 (bus, cpu->r.status | FLAG_BREAK); //push CPU cpu->r.status to stack
     flag_set(FLAG_INTERRUPT);
-    cpu->r.pc = (uint16_t)cpu_read(0xfffe) | ((uint16_t)cpu_read(0xffff) << 8);
+    cpu->r.pc = (uint16_t)cpu_read(bus, 0xfffe) | ((uint16_t)cpu_read(bus, 0xffff) << 8);
 }
 
-void bvc() /* Branch on overflow clear */
+void bvc (Bus * const bus) /* Branch on overflow clear */
 {
     get_opname();
     if (!(cpu->r.status & FLAG_OVERFLOW)) branch();
 }
 
-void bvs() /* Branch on overflow set */
+void bvs (Bus * const bus) /* Branch on overflow set */
 {
     get_opname();
     if (cpu->r.status & FLAG_OVERFLOW) branch();
 }
 
-void clc() /* Clear carry */
+void clc (Bus * const bus) /* Clear carry */
 {
     get_opname();
     flag_clear(FLAG_CARRY);
 }
 
-void cld() /* Clear decimal */
+void cld (Bus * const bus) /* Clear decimal */
 {
     get_opname();
     flag_clear(FLAG_DECIMAL);
 }
 
-void cli() /* Clear interrupt disable */
+void cli (Bus * const bus) /* Clear interrupt disable */
 {
     get_opname();
     flag_clear(FLAG_INTERRUPT);
 }
 
-void clv() /* Clear overflow */
+void clv (Bus * const bus) /* Clear overflow */
 {
     get_opname();
     flag_clear(FLAG_OVERFLOW);
 }
 
-void cmp() /* Compare (with accumulator) */
+void cmp (Bus * const bus) /* Compare (with accumulator) */
 {
     get_opname();
-    penaltyop = 1;
-    cpu->value = getvalue();
+    cpu->penaltyop = 1;
+    cpu->value = getvalue(bus);
     cmpset(cpu->r.a);
     signcalc((uint16_t) cpu->r.a - cpu->value);
 }
 
-void cpx() /* Compare with X */
+void cpx (Bus * const bus) /* Compare with X */
 {
     get_opname();
-    cpu->value = getvalue();
+    cpu->value = getvalue(bus);
     cmpset(cpu->r.x);
     signcalc((uint16_t) cpu->r.x - cpu->value);
 }
 
-void cpy() /* Compare with Y */
+void cpy (Bus * const bus) /* Compare with Y */
 {
     get_opname();
-    cpu->value = getvalue();
+    cpu->value = getvalue(bus);
     cmpset(cpu->r.y);
     signcalc((uint16_t)cpu->r.y - cpu->value);
 }
 
-void dec() /* Decrement */
+void dec (Bus * const bus) /* Decrement */
 {
     get_opname();
-    cpu->value = getvalue();
+    cpu->value = getvalue(bus);
     uint16_t result = cpu->value - 1;
 
     zerocalc(result);
     signcalc(result);
 
-    putvalue(result);
+    putvalue(bus, result);
 }
 
-void dex() /* Decrement X */
+void dex (Bus * const bus) /* Decrement X */
 {
     get_opname();
     cpu->r.x--;
@@ -492,7 +518,7 @@ void dex() /* Decrement X */
     signcalc(cpu->r.x);
 }
 
-void dey() /* Decrement Y */
+void dey (Bus * const bus) /* Decrement Y */
 {
     get_opname();
     cpu->r.y--;
@@ -501,32 +527,32 @@ void dey() /* Decrement Y */
     signcalc(cpu->r.y);
 }
 
-void eor() /* Exclusive OR (with accumulator) */
+void eor (Bus * const bus) /* Exclusive OR (with accumulator) */
 {
     get_opname();
-    cpu->value = getvalue();
+    cpu->value = getvalue(bus);
     uint16_t result = (uint16_t) cpu->r.a ^ cpu->value;
 
     zerocalc(result);
     signcalc(result);
 
     saveaccum(result);
-    penaltyop = 1;  
+    cpu->penaltyop = 1;  
 }
 
-void inc() /* Increment */
+void inc (Bus * const bus) /* Increment */
 {
     get_opname();
-    cpu->value = getvalue();
+    cpu->value = getvalue(bus);
     uint16_t result = cpu->value + 1;
 
     zerocalc(result);
     signcalc(result);
 
-    putvalue(result);
+    putvalue(bus, result);
 }
 
-void inx() /* Increment X */
+void inx (Bus * const bus) /* Increment X */
 {
     get_opname();
     cpu->r.x++;
@@ -535,7 +561,7 @@ void inx() /* Increment X */
     signcalc(cpu->r.x);
 }
 
-void iny() /* Increment Y */
+void iny (Bus * const bus) /* Increment Y */
 {
     get_opname();
     cpu->r.y++;
@@ -544,56 +570,56 @@ void iny() /* Increment Y */
     signcalc(cpu->r.y);
 }
 
-void jmp() /* Jump */
+void jmp (Bus * const bus) /* Jump */
 {
     get_opname();
     cpu->r.pc = cpu->abs_addr;
 }
 
-void jsr() /* Jump subroutine */
+void jsr (Bus * const bus) /* Jump subroutine */
 {
     get_opname();
-    push16 (--cpu->r.pc);
+    push16 (bus, --cpu->r.pc);
     cpu->r.pc = cpu->abs_addr;
 }
 
-void lda() /* Load accumulator */
+void lda (Bus * const bus) /* Load accumulator */
 {
     get_opname();
-    penaltyop = 1;
-    cpu->value = getvalue();
+    cpu->penaltyop = 1;
+    cpu->value = getvalue(bus);
     cpu->r.a = (uint8_t)(cpu->value & 0xff);
 
     zerocalc(cpu->r.a);
     signcalc(cpu->r.a);
 }
 
-void ldx() /* Load X */
+void ldx (Bus * const bus) /* Load X */
 {
     get_opname();
-    penaltyop = 1;
-    cpu->value = getvalue();
+    cpu->penaltyop = 1;
+    cpu->value = getvalue(bus);
     cpu->r.x = (uint8_t)(cpu->value & 0xff);
 
     zerocalc(cpu->r.x);
     signcalc(cpu->r.x);
 }
 
-void ldy() /* Load Y */
+void ldy (Bus * const bus) /* Load Y */
 {
     get_opname();
-    penaltyop = 1;
-    cpu->value = getvalue();
+    cpu->penaltyop = 1;
+    cpu->value = getvalue(bus);
     cpu->r.y = (uint8_t)(cpu->value & 0x00ff);
 
     zerocalc(cpu->r.y);
     signcalc(cpu->r.y);
 }
 
-void lsr() 
+void lsr (Bus * const bus) 
 {
     get_opname();
-    cpu->value = getvalue();
+    cpu->value = getvalue(bus);
     uint16_t result = cpu->value >> 1;
 
     if (cpu->value & 1) {
@@ -605,10 +631,10 @@ void lsr()
     zerocalc(result);
     signcalc(result);
 
-    putvalue(result);
+    putvalue(bus, result);
 }
 
-void nop() 
+void nop (Bus * const bus) 
 {
     get_opname();
     switch (cpu->opcode) {
@@ -618,16 +644,16 @@ void nop()
         case 0x7C:
         case 0xDC:
         case 0xFC:
-            penaltyop = 1;
+            cpu->penaltyop = 1;
             break;
     }
 }
 
-void ora() 
+void ora (Bus * const bus) 
 {
     get_opname();
-    penaltyop = 1;
-    cpu->value = getvalue();
+    cpu->penaltyop = 1;
+    cpu->value = getvalue(bus);
     uint16_t result = (uint16_t) cpu->r.a | cpu->value;
 
     zerocalc(result);
@@ -636,53 +662,53 @@ void ora()
     saveaccum(result);
 }
 
-void pha() 
+void pha (Bus * const bus) 
 {
     get_opname();
-    push8(cpu->r.a);
+    push8(bus, cpu->r.a);
 }
 
-void php() 
+void php (Bus * const bus) 
 {
     get_opname();
-    push8(cpu->r.status | FLAG_BREAK | FLAG_CONSTANT);
+    push8(bus, cpu->r.status | FLAG_BREAK | FLAG_CONSTANT);
     cpu->r.status &= (~FLAG_CONSTANT);
 }
 
-void pla() 
+void pla (Bus * const bus) 
 {
     get_opname();
-    cpu->r.a = pull8();
+    cpu->r.a = pull8(bus);
 
     zerocalc(cpu->r.a);
     signcalc(cpu->r.a);
 }
 
-void plp() 
+void plp (Bus * const bus) 
 {
     get_opname();
-    cpu->r.status = pull8();
+    cpu->r.status = pull8(bus);
 	cpu->r.status |= FLAG_CONSTANT;
     cpu->r.status &= (~FLAG_BREAK);
 }
 
-void rol() 
+void rol (Bus * const bus) 
 {
     get_opname();
-    cpu->value = getvalue();
+    cpu->value = getvalue(bus);
     uint16_t result = (cpu->value << 1) | (cpu->r.status & FLAG_CARRY);
 
     carrycalc(result);
     zerocalc(result);
     signcalc(result);
 
-    putvalue(result);
+    putvalue(bus, result);
 }
 
-void ror() 
+void ror (Bus * const bus) 
 {
     get_opname();
-    cpu->value = getvalue();
+    cpu->value = getvalue(bus);
     uint16_t result = (cpu->value >> 1) | ((cpu->r.status & FLAG_CARRY) << 7);
 
     if (cpu->value & 1) flag_set(FLAG_CARRY);
@@ -690,29 +716,29 @@ void ror()
     zerocalc(result);
     signcalc(result);
 
-    putvalue(result);
+    putvalue(bus, result);
 }
 
-void rti() 
+void rti (Bus * const bus) 
 {
     get_opname();
-    cpu->r.status = pull8();
-    cpu->value = pull16();
+    cpu->r.status = pull8(bus);
+    cpu->value = pull16(bus);
     cpu->r.pc = cpu->value;
 }
 
-void rts() 
+void rts (Bus * const bus) 
 {
     get_opname();
-    cpu->value = pull16();
+    cpu->value = pull16(bus);
     cpu->r.pc = cpu->value + 1;
 }
 
-void sbc() /* Subtract with carry */
+void sbc (Bus * const bus) /* Subtract with carry */
 {
     get_opname();
 
-    cpu->value = (uint16_t)getvalue() ^ 0xff;
+    cpu->value = (uint16_t)getvalue(bus) ^ 0xff;
     uint16_t result = cpu->r.a + cpu->value + (cpu->r.status & FLAG_CARRY);
 
     carrycalc(result);
@@ -721,46 +747,46 @@ void sbc() /* Subtract with carry */
     signcalc(result);
 
     saveaccum(result);
-    penaltyop = 1;
+    cpu->penaltyop = 1;
 }
 
-void sec() 
+void sec (Bus * const bus) 
 {
     get_opname();
     flag_set(FLAG_CARRY);
 }
 
-void sed() 
+void sed (Bus * const bus) 
 {
     get_opname();
     flag_set(FLAG_DECIMAL);
 }
 
-void sei() 
+void sei (Bus * const bus) 
 {
     get_opname();
     flag_set(FLAG_INTERRUPT);
 }
 
-void sta() 
+void sta (Bus * const bus) 
 {
     get_opname();
-    putvalue(cpu->r.a);
+    putvalue(bus, cpu->r.a);
 }
 
-void stx() 
+void stx (Bus * const bus) 
 {
     get_opname();
-    putvalue(cpu->r.x);
+    putvalue(bus, cpu->r.x);
 }
 
-void sty() 
+void sty (Bus * const bus) 
 {
     get_opname();
-    putvalue(cpu->r.y);
+    putvalue(bus, cpu->r.y);
 }
 
-void tax() 
+void tax (Bus * const bus) 
 {
     get_opname();
     cpu->r.x = cpu->r.a;
@@ -769,7 +795,7 @@ void tax()
     signcalc(cpu->r.x);
 }
 
-void tay() 
+void tay (Bus * const bus) 
 {
     get_opname();
     cpu->r.y = cpu->r.a;
@@ -778,7 +804,7 @@ void tay()
     signcalc(cpu->r.y);
 }
 
-void tsx() 
+void tsx (Bus * const bus) 
 {
     get_opname();
     cpu->r.x = cpu->r.sp;
@@ -787,7 +813,7 @@ void tsx()
     signcalc(cpu->r.x);
 }
 
-void txa() 
+void txa (Bus * const bus) 
 {
     get_opname();
     cpu->r.a = cpu->r.x;
@@ -796,13 +822,13 @@ void txa()
     signcalc(cpu->r.a);
 }
 
-void txs() 
+void txs (Bus * const bus) 
 {
     get_opname();
     cpu->r.sp = cpu->r.x;
 }
 
-void tya() 
+void tya (Bus * const bus) 
 {
     get_opname();
     cpu->r.a = cpu->r.y;
@@ -813,60 +839,60 @@ void tya()
 
 /* Unofficial opcodes */
 
-static void lax() {
+static void lax (Bus * const bus) {
     get_opname();
-    lda();
-    ldx();
+    lda(bus);
+    ldx(bus);
 }
 
-static void sax() {
+static void sax (Bus * const bus) {
     get_opname();
-    sta();
-    stx();
-    putvalue (cpu->r.a & cpu->r.x);
-    if (penaltyop && penaltyaddr) cpu->clockticks--;
+    sta(bus);
+    stx(bus);
+    putvalue (bus, cpu->r.a & cpu->r.x);
+    if (cpu->penaltyop && cpu->penaltyaddr) cpu->clockticks--;
 }
 
-static void dcp() {
+static void dcp (Bus * const bus) {
     get_opname();
-    dec();
-    cmp();
-    if (penaltyop && penaltyaddr) cpu->clockticks--;
+    dec(bus);
+    cmp(bus);
+    if (cpu->penaltyop && cpu->penaltyaddr) cpu->clockticks--;
 }
 
-static void isc() {
+static void isc (Bus * const bus) {
     get_opname();
-    inc();
-    sbc();
-    if (penaltyop && penaltyaddr) cpu->clockticks--;
+    inc(bus);
+    sbc(bus);
+    if (cpu->penaltyop && cpu->penaltyaddr) cpu->clockticks--;
 }
 
-static void slo() {
+static void slo (Bus * const bus) {
     get_opname();
-    asl();
-    ora();
-    if (penaltyop && penaltyaddr) cpu->clockticks--;
+    asl(bus);
+    ora(bus);
+    if (cpu->penaltyop && cpu->penaltyaddr) cpu->clockticks--;
 }
 
-static void rla() {
+static void rla (Bus * const bus) {
     get_opname();
-    rol();
-    and();
-    if (penaltyop && penaltyaddr) cpu->clockticks--;
+    rol(bus);
+    and(bus);
+    if (cpu->penaltyop && cpu->penaltyaddr) cpu->clockticks--;
 }
 
-static void sre() {
+static void sre (Bus * const bus) {
     get_opname();
-    lsr();
-    eor();
-    if (penaltyop && penaltyaddr) cpu->clockticks--;
+    lsr(bus);
+    eor(bus);
+    if (cpu->penaltyop && cpu->penaltyaddr) cpu->clockticks--;
 }
 
-static void rra() {
+static void rra (Bus * const bus) {
     get_opname();
-    ror();
-    adc();
-    if (penaltyop && penaltyaddr) cpu->clockticks--;
+    ror(bus);
+    adc(bus);
+    if (cpu->penaltyop && cpu->penaltyaddr) cpu->clockticks--;
 }
 
 /* Opcodes are grouped by type, then fetched later via ordering in the table */
@@ -917,28 +943,270 @@ struct Instruction optable[256] = {
         { isc, idx, 8 }, { isc, zp, 5 }, { sbc, imm, 2 }, { isc, abso,6 }, { isc, idy, 8 }, { isc, zpx, 6 }, { isc, absy, 7 }, { isc, absx, 7 }
 };
 
-void nmi() 
+void nmi (Bus * const bus) 
 {
-    push16 (cpu->r.pc);
+    push16 (bus, cpu->r.pc);
     flag_clear (FLAG_BREAK);
     flag_set (FLAG_CONSTANT);
+    push8 (bus, cpu->r.status);
+
+    /* Interrupts are masked after the status is pushed, RTI unmasks them again */
     flag_set (FLAG_INTERRUPT);
-    push8 (cpu->r.status);
 
-	cpu->r.pc = (uint16_t)cpu_read(0xfffa) | ((uint16_t)cpu_read(0xfffb) << 8);
-	cpu->clockticks += 8;
+	cpu->r.pc = (uint16_t)cpu_read(bus, 0xfffa) | ((uint16_t)cpu_read(bus, 0xfffb) << 8);
+	cpu->clockticks = 7;
 }
 
-void irq() 
+void irq (Bus * const bus) 
 {
-    push16 (cpu->r.pc);
-    push8(cpu->r.status);
+    push16 (bus, cpu->r.pc);
+    flag_clear (FLAG_BREAK);
+    flag_set (FLAG_CONSTANT);
+    push8(bus, cpu->r.status);
     flag_set (FLAG_INTERRUPT);
 
-    cpu->r.pc = (uint16_t)cpu_read(0xfffe) | ((uint16_t)cpu_read(0xffff) << 8);
-	cpu->clockticks += 7;
+    cpu->r.pc = (uint16_t)cpu_read(bus, 0xfffe) | ((uint16_t)cpu_read(bus, 0xffff) << 8);
+	cpu->clockticks = 7;
+}
+
+#ifndef CPU_TABLE_CORE
+
+/* Switch dispatch core *****************************
+ * Addressing mode and operation are expanded in place for each opcode, so an
+ * instruction costs one dispatch instead of two calls through optable. The
+ * table core above remains as the reference, selected with CPU_TABLE_CORE */
+
+/* Addressing modes: resolve the effective address into addr (or rel offset) */
+
+#define AM_impl
+#define AM_acc
+#define AM_imm  addr = cpu->r.pc++;
+#define AM_zp   addr = cpu_read(bus, cpu->r.pc++);
+#define AM_zpx  addr = (cpu_read(bus, cpu->r.pc++) + cpu->r.x) & 0xff;
+#define AM_zpy  addr = (cpu_read(bus, cpu->r.pc++) + cpu->r.y) & 0xff;
+
+#define AM_rel { \
+    addr = cpu_read(bus, cpu->r.pc++);\
+    if (addr & 0x80) addr |= 0xff00;\
+}
+
+#define AM_abso { \
+    addr  = cpu_read(bus, cpu->r.pc++);\
+    addr |= cpu_read(bus, cpu->r.pc++) << 8;\
 }
 
+#define AM_index(reg) { \
+    uint16_t base = cpu_read(bus, cpu->r.pc++);\
+    base |= cpu_read(bus, cpu->r.pc++) << 8;\
+    addr  = base + reg;\
+    cross = (addr & 0xff00) != (base & 0xff00);\
+}
+#define AM_absx AM_index(cpu->r.x)
+#define AM_absy AM_index(cpu->r.y)
+
+#define AM_ind { \
+    uint16_t ptr = cpu_read(bus, cpu->r.pc++);\
+    ptr |= cpu_read(bus, cpu->r.pc++) << 8;\
+    /* Simulate page boundary hardware bug */\
+    addr = cpu_read(bus, ptr) | (cpu_read(bus, (ptr & 0xff00) | ((ptr + 1) & 0xff)) << 8);\
+}
+
+#define AM_idx { \
+    uint8_t t = cpu_read(bus, cpu->r.pc++) + cpu->r.x;\
+    addr = cpu_read(bus, t) | (cpu_read(bus, (uint8_t)(t + 1)) << 8);\
+}
+
+#define AM_idy { \
+    uint8_t  t = cpu_read(bus, cpu->r.pc++);\
+    uint16_t base = cpu_read(bus, t) | (cpu_read(bus, (uint8_t)(t + 1)) << 8);\
+    addr  = base + cpu->r.y;\
+    cross = (addr & 0xff00) != (base & 0xff00);\
+}
+
+/* Operations, working on addr and adding page-cross penalties to ticks */
+
+#define NZ(reg) { zerocalc(reg); signcalc(reg); }
+
+#define LOAD(reg)         { reg = cpu_read(bus, addr); NZ(reg); ticks += cross; }
+#define TRANSFER(reg, n)  { reg = n; NZ(reg); }
+#define STEP(reg, n)      { reg += n; NZ(reg); }
+#define LOGIC(op, m)      { cpu->r.a = cpu->r.a op (m); NZ(cpu->r.a); }
+
+#define COMPARE(reg, m) { \
+    value = m;\
+    if (reg >= value) flag_set(FLAG_CARRY);\
+        else flag_clear(FLAG_CARRY);\
+    if (reg == value) flag_set(FLAG_ZERO);\
+        else flag_clear(FLAG_ZERO);\
+    signcalc(reg - value);\
+}
+
+#define ADD(m) { \
+    value  = m;\
+    result = cpu->r.a + value + (cpu->r.status & FLAG_CARRY);\
+    carrycalc(result);\
+    zerocalc(result);\
+    overflowcalc(result, cpu->r.a, value);\
+    signcalc(result);\
+    cpu->r.a = result & 0xff;\
+}
+
+#define SHIFT_L(m, carryin) { \
+    result = ((m) << 1) | (carryin);\
+    carrycalc(result);\
+    zerocalc(result);\
+    signcalc(result);\
+    m = result & 0xff;\
+}
+
+#define SHIFT_R(m, carryin) { \
+    result = ((m) >> 1) | (carryin);\
+    if ((m) & 1) flag_set(FLAG_CARRY);\
+        else flag_clear(FLAG_CARRY);\
+    zerocalc(result);\
+    signcalc(result);\
+    m = result & 0xff;\
+}
+
+/* Read-modify-write on a temporary m, written back once */
+#define MODIFY(op) { \
+    uint8_t m = cpu_read(bus, addr);\
+    op;\
+    cpu_write(bus, addr, m);\
+}
+
+#define BRANCH(cond) if (cond) { \
+    uint16_t target = cpu->r.pc + addr;\
+    ticks += ((target & 0xff00) != (cpu->r.pc & 0xff00)) ? 2 : 1;\
+    cpu->r.pc = target;\
+}
+
+#define ROL_IN (cpu->r.status & FLAG_CARRY)
+#define ROR_IN ((cpu->r.status & FLAG_CARRY) << 7)
+
+#define OP_adc  { ADD(cpu_read(bus, addr)); ticks += cross; }
+#define OP_sbc  { ADD(cpu_read(bus, addr) ^ 0xff); ticks += cross; }
+#define OP_and  { LOGIC(&, cpu_read(bus, addr)); ticks += cross; }
+#define OP_eor  { LOGIC(^, cpu_read(bus, addr)); ticks += cross; }
+#define OP_ora  { LOGIC(|, cpu_read(bus, addr)); ticks += cross; }
+#define OP_cmp  { COMPARE(cpu->r.a, cpu_read(bus, addr)); ticks += cross; }
+#define OP_cpx  COMPARE(cpu->r.x, cpu_read(bus, addr))
+#define OP_cpy  COMPARE(cpu->r.y, cpu_read(bus, addr))
+#define OP_lda  LOAD(cpu->r.a)
+#define OP_ldx  LOAD(cpu->r.x)
+#define OP_ldy  LOAD(cpu->r.y)
+#define OP_sta  cpu_write(bus, addr, cpu->r.a);
+#define OP_stx  cpu_write(bus, addr, cpu->r.x);
+#define OP_sty  cpu_write(bus, addr, cpu->r.y);
+
+#define OP_bit { \
+    value = cpu_read(bus, addr);\
+    zerocalc(cpu->r.a & value);\
+    cpu->r.status = (cpu->r.status & 0x3f) | (uint8_t)(value & 0xc0);\
+}
+
+#define OP_asl   MODIFY(SHIFT_L(m, 0))
+#define OP_rol   MODIFY(SHIFT_L(m, ROL_IN))
+#define OP_lsr   MODIFY(SHIFT_R(m, 0))
+#define OP_ror   MODIFY(SHIFT_R(m, ROR_IN))
+#define OP_asl_a SHIFT_L(cpu->r.a, 0)
+#define OP_rol_a SHIFT_L(cpu->r.a, ROL_IN)
+#define OP_lsr_a SHIFT_R(cpu->r.a, 0)
+#define OP_ror_a SHIFT_R(cpu->r.a, ROR_IN)
+#define OP_inc   MODIFY(STEP(m, 1))
+#define OP_dec   MODIFY(STEP(m, -1))
+#define OP_inx   STEP(cpu->r.x, 1)
+#define OP_iny   STEP(cpu->r.y, 1)
+#define OP_dex   STEP(cpu->r.x, -1)
+#define OP_dey   STEP(cpu->r.y, -1)
+
+#define OP_bcc BRANCH(!(cpu->r.status & FLAG_CARRY))
+#define OP_bcs BRANCH(cpu->r.status & FLAG_CARRY)
+#define OP_bne BRANCH(!(cpu->r.status & FLAG_ZERO))
+#define OP_beq BRANCH(cpu->r.status & FLAG_ZERO)
+#define OP_bpl BRANCH(!(cpu->r.status & FLAG_SIGN))
+#define OP_bmi BRANCH(cpu->r.status & FLAG_SIGN)
+#define OP_bvc BRANCH(!(cpu->r.status & FLAG_OVERFLOW))
+#define OP_bvs BRANCH(cpu->r.status & FLAG_OVERFLOW)
+
+#define OP_clc flag_clear(FLAG_CARRY);
+#define OP_cld flag_clear(FLAG_DECIMAL);
+#define OP_cli flag_clear(FLAG_INTERRUPT);
+#define OP_clv flag_clear(FLAG_OVERFLOW);
+#define OP_sec flag_set(FLAG_CARRY);
+#define OP_sed flag_set(FLAG_DECIMAL);
+#define OP_sei flag_set(FLAG_INTERRUPT);
+
+#define OP_tax TRANSFER(cpu->r.x, cpu->r.a)
+#define OP_tay TRANSFER(cpu->r.y, cpu->r.a)
+#define OP_tsx TRANSFER(cpu->r.x, cpu->r.sp)
+#define OP_txa TRANSFER(cpu->r.a, cpu->r.x)
+#define OP_tya TRANSFER(cpu->r.a, cpu->r.y)
+#define OP_txs cpu->r.sp = cpu->r.x;
+
+#define OP_pha push8(bus, cpu->r.a);
+#define OP_pla TRANSFER(cpu->r.a, pull8(bus))
+#define OP_php { \
+    push8(bus, cpu->r.status | FLAG_BREAK | FLAG_CONSTANT);\
+    cpu->r.status &= (~FLAG_CONSTANT);\
+}
+#define OP_plp cpu->r.status = (pull8(bus) | FLAG_CONSTANT) & (~FLAG_BREAK);
+
+#define OP_brk { \
+    push16(bus, ++cpu->r.pc);\
+    push8(bus, cpu->r.status | FLAG_BREAK);\
+    flag_set(FLAG_INTERRUPT);\
+    cpu->r.pc = (uint16_t)cpu_read(bus, 0xfffe) | ((uint16_t)cpu_read(bus, 0xffff) << 8);\
+}
+#define OP_jmp cpu->r.pc = addr;
+#define OP_jsr { push16(bus, --cpu->r.pc); cpu->r.pc = addr; }
+#define OP_rti { cpu->r.status = pull8(bus); cpu->r.pc = pull16(bus); }
+#define OP_rts cpu->r.pc = pull16(bus) + 1;
+
+#define OP_nop
+#define OP_nopx ticks += cross;
+
+/* Unofficial opcodes, combined read-modify-write ops take no penalty */
+
+#define OP_lax { LOAD(cpu->r.a); cpu->r.x = cpu->r.a; }
+#define OP_sax cpu_write(bus, addr, cpu->r.a & cpu->r.x);
+#define OP_slo MODIFY(SHIFT_L(m, 0);      LOGIC(|, m))
+#define OP_rla MODIFY(SHIFT_L(m, ROL_IN); LOGIC(&, m))
+#define OP_sre MODIFY(SHIFT_R(m, 0);      LOGIC(^, m))
+#define OP_rra MODIFY(SHIFT_R(m, ROR_IN); ADD(m))
+#define OP_dcp MODIFY(m--; COMPARE(cpu->r.a, m))
+#define OP_isc MODIFY(m++; ADD(m ^ 0xff))
+
+static uint8_t cpu_execute (Bus * const bus, uint8_t const opcode)
+{
+    uint16_t addr = 0, value = 0, result = 0;
+    uint8_t  ticks = 0, cross = 0;
+
+#ifdef CPU_COMPUTED_GOTO
+    #define OP(code, n, mode, op) &&op_##code,
+    static void * const dispatch[256] = {
+        #include "cpu6502_ops.h"
+    };
+    #undef OP
+
+    #define OP(code, n, mode, op) op_##code: ticks = n; AM_##mode; OP_##op; goto done;
+    goto *dispatch[opcode];
+    #include "cpu6502_ops.h"
+    #undef OP
+done:
+#else
+    #define OP(code, n, mode, op) case code: ticks = n; AM_##mode; OP_##op; break;
+    switch (opcode)
+    {
+        #include "cpu6502_ops.h"
+    }
+    #undef OP
+#endif
+    return ticks;
+}
+
+#endif /* CPU_TABLE_CORE */
+
 #ifdef OPTABLES
 
 void cpu_disassemble (Bus * const bus, uint16_t const start, uint16_t const end)
@@ -957,7 +1225,7 @@ void cpu_disassemble (Bus * const bus, uint16_t const start, uint16_t const end)
 		/* Read instruction, and get its readable name */
 		uint8_t opcode = bus_read (bus, addr);
         const uint8_t opID = ((opcode & 3) * 0x40) + (opcode >> 2);
-        (*optable[opID].op)();
+        (*optable[opID].op)(bus);
 
         sprintf(textbuf, "$%04x: %02x ", addr, opID);
 		strcat(sInst, textbuf);
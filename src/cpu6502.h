@@ -3,19 +3,7 @@
 
 typedef struct CPU6502_struct
 {
-    /* Status flags */
-    enum status 
-    {
-        FLAG_CARRY     = 0x01,
-        FLAG_ZERO      = 0x02,
-        FLAG_INTERRUPT = 0x04,
-        FLAG_DECIMAL   = 0x08,
-        FLAG_BREAK     = 0x10,
-        FLAG_CONSTANT  = 0x20,
-        FLAG_OVERFLOW  = 0x40,
-        FLAG_SIGN      = 0x80
-    }
-    status;
+    /* Hot state, used by every instruction. Kept within the first 64 bytes */
 
     /* 6502 CPU registers */
 	struct Registers 
@@ -27,14 +15,30 @@ typedef struct CPU6502_struct
 	} r;
 
     /* Helper vars */
-    uint64_t instructions, clockCount, clockGoal;
-    uint16_t lastpc, abs_addr, rel_addr, value;
     uint8_t  opcode;
     uint8_t  clockticks;
+    uint8_t  penaltyop, penaltyaddr;
+    uint8_t  opID;
+    uint16_t abs_addr, rel_addr, value;
+    uint64_t instructions, clockCount, clockGoal;
+
+    /* Status flags */
+    enum status 
+    {
+        FLAG_CARRY     = 0x01,
+        FLAG_ZERO      = 0x02,
+        FLAG_INTERRUPT = 0x04,
+        FLAG_DECIMAL   = 0x08,
+        FLAG_BREAK     = 0x10,
+        FLAG_CONSTANT  = 0x20,
+        FLAG_OVERFLOW  = 0x40,
+        FLAG_SIGN      = 0x80
+    }
+    status;
 
     /* Meta vars */
+    uint16_t lastpc;
     uint8_t  debug;
-    uint8_t  opID;
     char     lastop[8], lastmode[8];
 
     /* Constants */
@@ -42,21 +46,28 @@ typedef struct CPU6502_struct
 }
 CPU6502;
 
+/* Forward declaration */
+typedef struct Bus_struct Bus;
+
 /* Instrction/address mode/tick grouping */
 struct Instruction
 {		
-    void    (*op)();
-    uint8_t (*addrmode)();
+    void    (*op)(Bus * const);
+    uint8_t (*addrmode)(Bus * const);
     uint8_t ticks;
 };
 
-/* Forward declaration */
-typedef struct Bus_struct Bus;
-
 #define BASE_STACK        0x100
 
-void cpu_reset       (CPU6502 * const cpu);
-void cpu_clock       (Bus     * const bus);
-void cpu_exec        (CPU6502 * const cpu, uint32_t const tickcount);
-void cpu_disassemble (Bus     * const bus, uint16_t const start, uint16_t const end);
-void nmi();
\ No newline at end of file
+/* Interpreter core selection. The default core dispatches once per opcode
+   through a switch; define CPU_COMPUTED_GOTO to use GCC label addresses
+   instead, or CPU_TABLE_CORE for the optable reference core */
+
+void    cpu_reset       (Bus     * const bus);
+void    cpu_exec        (CPU6502 * const cpu, uint32_t const tickcount);
+void    cpu_disassemble (Bus     * const bus, uint16_t const start, uint16_t const end);
+
+/* Run one whole instruction (or pending NMI), returns the cycles it took */
+uint8_t cpu_clock       (Bus     * const bus);
+void    nmi             (Bus     * const bus);
+void    irq             (Bus     * const bus);
\ No newline at end of file
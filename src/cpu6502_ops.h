@@ -0,0 +1,275 @@
+/* Opcode list for the switch/goto interpreter core in cpu6502.c
+ * OP(opcode, cycles, addressing mode, operation), ordered by opcode.
+ * Cycle counts mirror optable; this file is included once per expansion of OP */
+
+OP(0x00, 7, impl, brk)
+OP(0x01, 6, idx,  ora)
+OP(0x02, 2, impl, nop)
+OP(0x03, 8, idx,  slo)
+OP(0x04, 3, zp,   nop)
+OP(0x05, 3, zp,   ora)
+OP(0x06, 5, zp,   asl)
+OP(0x07, 5, zp,   slo)
+OP(0x08, 3, impl, php)
+OP(0x09, 2, imm,  ora)
+OP(0x0a, 2, acc,  asl_a)
+OP(0x0b, 2, imm,  nop)
+OP(0x0c, 4, abso, nop)
+OP(0x0d, 4, abso, ora)
+OP(0x0e, 6, abso, asl)
+OP(0x0f, 6, abso, slo)
+
+OP(0x10, 2, rel,  bpl)
+OP(0x11, 5, idy,  ora)
+OP(0x12, 2, impl, nop)
+OP(0x13, 8, idy,  slo)
+OP(0x14, 4, zpx,  nop)
+OP(0x15, 4, zpx,  ora)
+OP(0x16, 6, zpx,  asl)
+OP(0x17, 6, zpx,  slo)
+OP(0x18, 2, impl, clc)
+OP(0x19, 4, absy, ora)
+OP(0x1a, 2, impl, nop)
+OP(0x1b, 7, absy, slo)
+OP(0x1c, 4, absx, nopx)
+OP(0x1d, 4, absx, ora)
+OP(0x1e, 7, absx, asl)
+OP(0x1f, 7, absx, slo)
+
+OP(0x20, 6, abso, jsr)
+OP(0x21, 6, idx,  and)
+OP(0x22, 2, impl, nop)
+OP(0x23, 8, idx,  rla)
+OP(0x24, 3, zp,   bit)
+OP(0x25, 3, zp,   and)
+OP(0x26, 5, zp,   rol)
+OP(0x27, 5, zp,   rla)
+OP(0x28, 4, impl, plp)
+OP(0x29, 2, imm,  and)
+OP(0x2a, 2, acc,  rol_a)
+OP(0x2b, 2, imm,  nop)
+OP(0x2c, 4, abso, bit)
+OP(0x2d, 4, abso, and)
+OP(0x2e, 6, abso, rol)
+OP(0x2f, 6, abso, rla)
+
+OP(0x30, 2, rel,  bmi)
+OP(0x31, 5, idy,  and)
+OP(0x32, 2, impl, nop)
+OP(0x33, 8, idy,  rla)
+OP(0x34, 4, zpx,  nop)
+OP(0x35, 4, zpx,  and)
+OP(0x36, 6, zpx,  rol)
+OP(0x37, 6, zpx,  rla)
+OP(0x38, 2, impl, sec)
+OP(0x39, 4, absy, and)
+OP(0x3a, 2, impl, nop)
+OP(0x3b, 7, absy, rla)
+OP(0x3c, 4, absx, nopx)
+OP(0x3d, 4, absx, and)
+OP(0x3e, 7, absx, rol)
+OP(0x3f, 7, absx, rla)
+
+OP(0x40, 6, impl, rti)
+OP(0x41, 6, idx,  eor)
+OP(0x42, 2, impl, nop)
+OP(0x43, 8, idx,  sre)
+OP(0x44, 3, zp,   nop)
+OP(0x45, 3, zp,   eor)
+OP(0x46, 5, zp,   lsr)
+OP(0x47, 5, zp,   sre)
+OP(0x48, 3, impl, pha)
+OP(0x49, 2, imm,  eor)
+OP(0x4a, 2, acc,  lsr_a)
+OP(0x4b, 2, imm,  nop)
+OP(0x4c, 3, abso, jmp)
+OP(0x4d, 4, abso, eor)
+OP(0x4e, 6, abso, lsr)
+OP(0x4f, 6, abso, sre)
+
+OP(0x50, 2, rel,  bvc)
+OP(0x51, 5, idy,  eor)
+OP(0x52, 2, impl, nop)
+OP(0x53, 8, idy,  sre)
+OP(0x54, 4, zpx,  nop)
+OP(0x55, 4, zpx,  eor)
+OP(0x56, 6, zpx,  lsr)
+OP(0x57, 6, zpx,  sre)
+OP(0x58, 4, impl, cli)
+OP(0x59, 4, absy, eor)
+OP(0x5a, 2, impl, nop)
+OP(0x5b, 7, absy, sre)
+OP(0x5c, 4, absx, nopx)
+OP(0x5d, 4, absx, eor)
+OP(0x5e, 7, absx, lsr)
+OP(0x5f, 7, absx, sre)
+
+OP(0x60, 6, impl, rts)
+OP(0x61, 6, idx,  adc)
+OP(0x62, 2, impl, nop)
+OP(0x63, 8, idx,  rra)
+OP(0x64, 3, zp,   nop)
+OP(0x65, 3, zp,   adc)
+OP(0x66, 5, zp,   ror)
+OP(0x67, 5, zp,   rra)
+OP(0x68, 4, impl, pla)
+OP(0x69, 2, imm,  adc)
+OP(0x6a, 2, acc,  ror_a)
+OP(0x6b, 2, imm,  nop)
+OP(0x6c, 5, ind,  jmp)
+OP(0x6d, 4, abso, adc)
+OP(0x6e, 6, abso, ror)
+OP(0x6f, 6, abso, rra)
+
+OP(0x70, 2, rel,  bvs)
+OP(0x71, 5, idy,  adc)
+OP(0x72, 2, impl, nop)
+OP(0x73, 8, idy,  rra)
+OP(0x74, 4, zpx,  nop)
+OP(0x75, 4, zpx,  adc)
+OP(0x76, 6, zpx,  ror)
+OP(0x77, 6, zpx,  rra)
+OP(0x78, 2, impl, sei)
+OP(0x79, 4, absy, adc)
+OP(0x7a, 2, impl, nop)
+OP(0x7b, 7, absy, rra)
+OP(0x7c, 4, absx, nopx)
+OP(0x7d, 4, absx, adc)
+OP(0x7e, 7, absx, ror)
+OP(0x7f, 7, absx, rra)
+
+OP(0x80, 2, imm,  nop)
+OP(0x81, 6, idx,  sta)
+OP(0x82, 2, imm,  nop)
+OP(0x83, 6, idx,  sax)
+OP(0x84, 3, zp,   sty)
+OP(0x85, 3, zp,   sta)
+OP(0x86, 3, zp,   stx)
+OP(0x87, 3, zp,   sax)
+OP(0x88, 2, impl, dey)
+OP(0x89, 2, imm,  nop)
+OP(0x8a, 2, impl, txa)
+OP(0x8b, 2, imm,  sax)
+OP(0x8c, 4, abso, sty)
+OP(0x8d, 4, abso, sta)
+OP(0x8e, 4, abso, stx)
+OP(0x8f, 4, abso, sax)
+
+OP(0x90, 2, rel,  bcc)
+OP(0x91, 6, idy,  sta)
+OP(0x92, 2, impl, nop)
+OP(0x93, 6, idy,  nop)
+OP(0x94, 4, zpx,  sty)
+OP(0x95, 4, zpx,  sta)
+OP(0x96, 4, zpy,  stx)
+OP(0x97, 4, zpy,  sax)
+OP(0x98, 2, impl, tya)
+OP(0x99, 5, absy, sta)
+OP(0x9a, 2, impl, txs)
+OP(0x9b, 5, absy, nop)
+OP(0x9c, 5, absx, nop)
+OP(0x9d, 5, absx, sta)
+OP(0x9e, 5, absy, nop)
+OP(0x9f, 5, absy, sax)
+
+OP(0xa0, 2, imm,  ldy)
+OP(0xa1, 6, idx,  lda)
+OP(0xa2, 2, imm,  ldx)
+OP(0xa3, 6, idx,  lax)
+OP(0xa4, 3, zp,   ldy)
+OP(0xa5, 3, zp,   lda)
+OP(0xa6, 3, zp,   ldx)
+OP(0xa7, 3, zp,   lax)
+OP(0xa8, 2, impl, tay)
+OP(0xa9, 2, imm,  lda)
+OP(0xaa, 2, impl, tax)
+OP(0xab, 2, imm,  lax)
+OP(0xac, 4, abso, ldy)
+OP(0xad, 4, abso, lda)
+OP(0xae, 4, abso, ldx)
+OP(0xaf, 4, abso, lax)
+
+OP(0xb0, 2, rel,  bcs)
+OP(0xb1, 5, idy,  lda)
+OP(0xb2, 2, impl, nop)
+OP(0xb3, 5, idy,  lax)
+OP(0xb4, 4, zpx,  ldy)
+OP(0xb5, 4, zpx,  lda)
+OP(0xb6, 4, zpy,  ldx)
+OP(0xb7, 4, zpy,  lax)
+OP(0xb8, 2, impl, clv)
+OP(0xb9, 4, absy, lda)
+OP(0xba, 2, impl, tsx)
+OP(0xbb, 4, absy, nop)
+OP(0xbc, 4, absx, ldy)
+OP(0xbd, 4, absx, lda)
+OP(0xbe, 4, absy, ldx)
+OP(0xbf, 4, absy, lax)
+
+OP(0xc0, 2, imm,  cpy)
+OP(0xc1, 6, idx,  cmp)
+OP(0xc2, 2, imm,  nop)
+OP(0xc3, 8, idx,  dcp)
+OP(0xc4, 3, zp,   cpy)
+OP(0xc5, 3, zp,   cmp)
+OP(0xc6, 5, zp,   dec)
+OP(0xc7, 5, zp,   dcp)
+OP(0xc8, 2, impl, iny)
+OP(0xc9, 2, imm,  cmp)
+OP(0xca, 2, impl, dex)
+OP(0xcb, 2, imm,  nop)
+OP(0xcc, 4, abso, cpy)
+OP(0xcd, 4, abso, cmp)
+OP(0xce, 6, abso, dec)
+OP(0xcf, 6, abso, dcp)
+
+OP(0xd0, 2, rel,  bne)
+OP(0xd1, 5, idy,  cmp)
+OP(0xd2, 2, impl, nop)
+OP(0xd3, 8, idy,  dcp)
+OP(0xd4, 4, zpx,  nop)
+OP(0xd5, 4, zpx,  cmp)
+OP(0xd6, 6, zpx,  dec)
+OP(0xd7, 6, zpx,  dcp)
+OP(0xd8, 2, impl, cld)
+OP(0xd9, 4, absy, cmp)
+OP(0xda, 2, impl, nop)
+OP(0xdb, 7, absy, dcp)
+OP(0xdc, 4, absx, nopx)
+OP(0xdd, 4, absx, cmp)
+OP(0xde, 7, absx, dec)
+OP(0xdf, 7, absx, dcp)
+
+OP(0xe0, 2, imm,  cpx)
+OP(0xe1, 6, idx,  sbc)
+OP(0xe2, 2, imm,  nop)
+OP(0xe3, 8, idx,  isc)
+OP(0xe4, 3, zp,   cpx)
+OP(0xe5, 3, zp,   sbc)
+OP(0xe6, 5, zp,   inc)
+OP(0xe7, 5, zp,   isc)
+OP(0xe8, 2, impl, inx)
+OP(0xe9, 2, imm,  sbc)
+OP(0xea, 2, impl, nop)
+OP(0xeb, 2, imm,  sbc)
+OP(0xec, 4, abso, cpx)
+OP(0xed, 4, abso, sbc)
+OP(0xee, 6, abso, inc)
+OP(0xef, 6, abso, isc)
+
+OP(0xf0, 2, rel,  beq)
+OP(0xf1, 5, idy,  sbc)
+OP(0xf2, 2, impl, nop)
+OP(0xf3, 8, idy,  isc)
+OP(0xf4, 4, zpx,  nop)
+OP(0xf5, 4, zpx,  sbc)
+OP(0xf6, 6, zpx,  inc)
+OP(0xf7, 6, zpx,  isc)
+OP(0xf8, 2, impl, sed)
+OP(0xf9, 4, absy, sbc)
+OP(0xfa, 2, impl, nop)
+OP(0xfb, 7, absy, isc)
+OP(0xfc, 4, absx, nopx)
+OP(0xfd, 4, absx, sbc)
+OP(0xfe, 7, absx, inc)
+OP(0xff, 7, absx, isc)
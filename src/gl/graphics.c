@@ -162,8 +162,11 @@ void graphics_init (Scene * const scene)
 
 #ifdef PPU_DEBUG
 
-void draw_ntable_debug (GLFWwindow * window, Scene * const scene)
+void draw_ntable_debug (GLFWwindow * window, Scene * const scene, PPU2C02 * const ppu)
 {
+    PPUDebug * const view = ppu_debug_view (ppu);
+    if (!view) return;
+
 	//glClearColor((GLfloat)scene->bgColor[0] / 255, (GLfloat)scene->bgColor[1] / 215, (GLfloat)scene->bgColor[2] / 184, 1.0);
 	//glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -187,7 +190,7 @@ void draw_ntable_debug (GLFWwindow * window, Scene * const scene)
 
     /* Draw PPU Nametable textures */
     glBindTexture (GL_TEXTURE_2D, scene->pTableTexture);
-    glTexImage2D  (GL_TEXTURE_2D, 0, GL_RGBA, 256, 240, 0, GL_RGB, GL_UNSIGNED_BYTE, NES.ppu.nTableDebug[0]);
+    glTexImage2D  (GL_TEXTURE_2D, 0, GL_RGBA, 256, 240, 0, GL_RGB, GL_UNSIGNED_BYTE, view->nTable[0]);
 	draw_lazy_quad(1.0f, 1.0f, 1);
 
     mat4x4_identity (model);
@@ -196,14 +199,17 @@ void draw_ntable_debug (GLFWwindow * window, Scene * const scene)
     glUniformMatrix4fv (glGetUniformLocation(scene->debugShader.program, "model"), 1, GL_FALSE, (const GLfloat*) model);
 
     glBindTexture (GL_TEXTURE_2D, scene->pTableTexture);
-    glTexImage2D  (GL_TEXTURE_2D, 0, GL_RGBA, 256, 240, 0, GL_RGB, GL_UNSIGNED_BYTE, NES.ppu.nTableDebug[1]);
+    glTexImage2D  (GL_TEXTURE_2D, 0, GL_RGBA, 256, 240, 0, GL_RGB, GL_UNSIGNED_BYTE, view->nTable[1]);
 	draw_lazy_quad(1.0f, 1.0f, 1);
 
     glBindTexture(GL_TEXTURE_2D, 0);
 }
 
-void draw_ptable_debug (GLFWwindow * window, Scene * const scene)
+void draw_ptable_debug (GLFWwindow * window, Scene * const scene, PPU2C02 * const ppu)
 {
+    PPUDebug * const view = ppu_debug_view (ppu);
+    if (!view) return;
+
 	glClearColor((GLfloat)scene->bgColor[0] / 255, (GLfloat)scene->bgColor[1] / 255, (GLfloat)scene->bgColor[2] / 224, 1.0);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -227,7 +233,7 @@ void draw_ptable_debug (GLFWwindow * window, Scene * const scene)
 
     /* Draw PPU Pattern Table textures */
     glBindTexture (GL_TEXTURE_2D, scene->pTableTexture);
-    glTexImage2D  (GL_TEXTURE_2D, 0, GL_RGBA, 128, 128, 0, GL_RGB, GL_UNSIGNED_BYTE, NES.ppu.pTableDebug[0]);
+    glTexImage2D  (GL_TEXTURE_2D, 0, GL_RGBA, 128, 128, 0, GL_RGB, GL_UNSIGNED_BYTE, view->pTable[0]);
 	draw_lazy_quad(1.0f, 1.0f, 1);
 
     mat4x4_ortho (projection, 0, width, 0, height, 0, 0.1f);
@@ -237,13 +243,13 @@ void draw_ptable_debug (GLFWwindow * window, Scene * const scene)
     glUniformMatrix4fv (glGetUniformLocation(scene->debugShader.program, "model"), 1, GL_FALSE, (const GLfloat*) model);
 
     glBindTexture (GL_TEXTURE_2D, scene->pTableTexture);
-    glTexImage2D  (GL_TEXTURE_2D, 0, GL_RGBA, 128, 128, 0, GL_RGB, GL_UNSIGNED_BYTE, NES.ppu.pTableDebug[1]);
+    glTexImage2D  (GL_TEXTURE_2D, 0, GL_RGBA, 128, 128, 0, GL_RGB, GL_UNSIGNED_BYTE, view->pTable[1]);
 	draw_lazy_quad(1.0f, 1.0f, 1);
 
     glBindTexture(GL_TEXTURE_2D, 0);
 }
 
-void draw_debug_tiles (int32_t const width, int32_t const height)
+void draw_debug_tiles (PPU2C02 * const ppu, int32_t const width, int32_t const height)
 {
     /* Draw PPU graphical output */
     //text_begin (width, height);
@@ -254,7 +260,7 @@ void draw_debug_tiles (int32_t const width, int32_t const height)
         sprintf(textbuf, " ");
         for (int x = 0; x < 32; x++)
         {
-            uint8_t tile = ppu_read(&NES.ppu, (y * 32 + x) + 0x2000);
+            uint8_t tile = ppu_read(ppu, (y * 32 + x) + 0x2000);
             sprintf(textbuf + strlen(textbuf), "%02x ", tile);
         }
         //text_draw_alpha (textbuf, 0, height - 10 - y * 24, 0.4f, 0xaaffffff);
@@ -263,7 +269,11 @@ void draw_debug_tiles (int32_t const width, int32_t const height)
 
 #endif
 
-void draw_scene (GLFWwindow * window, Scene * const scene)
+/* PPU frame converted to RGBA for upload, the 4 byte format converts with
+   the vector kernels and uploads without row unpacking */
+static uint8_t frameRGBA[256 * 240 * 4];
+
+void draw_scene (GLFWwindow * window, Scene * const scene, Bus * const bus)
 {
 	glClearColor((GLfloat)scene->bgColor[0] / 255, (GLfloat)scene->bgColor[1] / 255, (GLfloat)scene->bgColor[2] / 255, 1.0);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -286,18 +296,21 @@ void draw_scene (GLFWwindow * window, Scene * const scene)
     glActiveTexture (GL_TEXTURE0);
 
     /* Draw framebuffer */
+    nesemu_frame_pixels (bus, PIXEL_RGBA32, frameRGBA);
+
     glBindTexture (GL_TEXTURE_2D, scene->fbufferTexture);
-    glTexImage2D  (GL_TEXTURE_2D, 0, GL_RGBA, 256, 240, 0, GL_RGB, GL_UNSIGNED_BYTE, &NES.ppu.frameBuffer);
+    glTexImage2D  (GL_TEXTURE_2D, 0, GL_RGBA, 256, 240, 0, GL_RGBA, GL_UNSIGNED_BYTE, frameRGBA);
 	draw_lazy_quad(1.0f, 1.0f, 0);
 
     glBindTexture(GL_TEXTURE_2D, 0);
 
 #ifdef PPU_DEBUG  
-    draw_ntable_debug (window, scene);
+    if (ppu_show_debug (&bus->ppu))
+        draw_ntable_debug (window, scene, &bus->ppu);
 #endif
 }
 
-void draw_debug (GLFWwindow * window, Timer * const timer)
+void draw_debug (GLFWwindow * window, Timer * const timer, Bus * const bus)
 {
     int32_t width, height;
     glfwGetFramebufferSize (window, &width, &height);
@@ -320,14 +333,14 @@ void draw_debug (GLFWwindow * window, Timer * const timer)
     text_draw_raised (textbuf, wOffset, height - 48.0f, 0.5f, -1);
 
     /* Debug CPU and RAM */
-    sprintf(textbuf, "PC: $%04x %02x %s Clk: %ld", cpu->lastpc, cpu->opcode, cpu->lastop, cpu->clockCount);
+    sprintf(textbuf, "PC: $%04x %02x %s Clk: %ld", bus->cpu.lastpc, bus->cpu.opcode, bus->cpu.lastop, bus->cpu.clockCount);
     text_draw_raised (textbuf, wOffset, height - 64.0f, 0.5f, -1);
-    sprintf(textbuf, "Sec: %.3f", ((float)NES.ppu.scanline / 262.0f + NES.ppu.frame) / 60.0f);
+    sprintf(textbuf, "Sec: %.3f", ((float)bus->ppu.scanline / 262.0f + bus->ppu.frame) / 60.0f);
     text_draw_raised (textbuf, wOffset, height - 80.0f, 0.5f, -1);
-    sprintf(textbuf, "%s", NES.rom.filename);
+    sprintf(textbuf, "%s", bus->rom.filename);
     text_draw_raised (textbuf, wOffset, height - 160.0f, 0.5f, 0x44ddff);
 
     /* CPU registers and storage locations for program/vars */
-    draw_debug_cpu(wOffset, height - 112.0f);
+    draw_debug_cpu(&bus->cpu, wOffset, height - 112.0f);
 #endif
 }
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include "../timer.h"
 #include "../bus.h"
 #include "../palette.h"
+#include "../nesemu.h"
 #include "../utils/linmath.h"
 #include "gl_gen.h"
 #include "shader.h"
@@ -32,7 +33,7 @@ extern const char * ppu_fs_source;
 extern uint32_t quadVAO[2];
 
 void draw_lazy_quad (const float width, const float height, const int i);
-void draw_scene     (GLFWwindow *, Scene * const);
+void draw_scene     (GLFWwindow *, Scene * const, Bus * const);
 
 inline void texture_setup (uint32_t * const textureID, uint16_t width, uint16_t height, GLenum filter, const void * data)
 {
@@ -51,9 +52,9 @@ inline void texture_setup (uint32_t * const textureID, uint16_t width, uint16_t
 
 #ifdef CPU_DEBUG
 
-void draw_debug (GLFWwindow * window, Timer * const timer);
+void draw_debug (GLFWwindow * window, Timer * const timer, Bus * const bus);
 
-inline void draw_debug_cpu (int32_t const x, int32_t const y)
+inline void draw_debug_cpu (CPU6502 * const cpu, int32_t const x, int32_t const y)
 {
     char textbuf[256];
     const float size = 0.5f;
@@ -66,7 +67,7 @@ inline void draw_debug_cpu (int32_t const x, int32_t const y)
     text_draw_raised (textbuf, x , y - 32, size, -1);
 }
 
-inline void draw_debug_ram (int32_t const x, int32_t const y, int8_t rows, int8_t cols, int16_t const start)
+inline void draw_debug_ram (Bus * const bus, int32_t const x, int32_t const y, int8_t rows, int8_t cols, int16_t const start)
 {
     char textbuf[256];
     const float size = 0.45f;
@@ -83,7 +84,7 @@ inline void draw_debug_ram (int32_t const x, int32_t const y, int8_t rows, int8_
         sprintf(textbuf, "$%04x ", (uint16_t)addr);
         for (int j = 0; j < cols; j++)
         {
-            sprintf(textbuf + strlen(textbuf), "%02x ", bus_read(&NES, addr++)); 
+            sprintf(textbuf + strlen(textbuf), "%02x ", bus_read(bus, addr++)); 
         }
         text_draw_raised (textbuf, x, y - (i * 16), size, -1);
     }
@@ -93,9 +94,9 @@ inline void draw_debug_ram (int32_t const x, int32_t const y, int8_t rows, int8_
 
 #ifdef PPU_DEBUG
 
-void draw_ntable_debug (GLFWwindow * const, Scene * const);
-void draw_ptable_debug (GLFWwindow * const, Scene * const);
-void draw_debug_tiles  (int32_t const width, int32_t const height);
+void draw_ntable_debug (GLFWwindow * const, Scene * const, PPU2C02 * const);
+void draw_ptable_debug (GLFWwindow * const, Scene * const, PPU2C02 * const);
+void draw_debug_tiles  (PPU2C02 * const, int32_t const width, int32_t const height);
 
 #endif
 
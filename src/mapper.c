@@ -2,170 +2,416 @@
 #include <stdlib.h>
 #include "mapper.h"
 
-uint8_t (*mapperRead[NUM_MAPPERS])(Mapper*, uint16_t, uint8_t) = 
-{
-    mapper_NROM_read,
-    mapper_MMC1_read,
-    mapper_UxROM_read,
-    mapper_CNROM_read
-};
+extern inline uint8_t mapper_CHR_read  (Mapper * const mapper, uint16_t const address);
+extern inline void    mapper_CHR_write (Mapper * const mapper, uint16_t const address, uint8_t const data);
 
-void (*mapperWrite[NUM_MAPPERS])(Mapper*, uint16_t, uint8_t, uint8_t) = 
+void (*mapperWrite[NUM_MAPPERS])(Mapper*, uint16_t, uint8_t) = 
 {
     mapper_NROM_write,
     mapper_MMC1_write,
     mapper_UxROM_write,
-    mapper_CNROM_write
+    mapper_CNROM_write,
+    mapper_MMC3_write
+};
+
+void (*mapperMap[NUM_MAPPERS])(Mapper*) = 
+{
+    mapper_NROM_map,
+    mapper_MMC1_map,
+    mapper_UxROM_map,
+    mapper_CNROM_map,
+    mapper_MMC3_map
+};
+
+/* Size of the props each mapper keeps, and what sets them up at power on */
+
+static const uint16_t mapperPropsSize[NUM_MAPPERS] =
+{
+    0,
+    sizeof(struct MMC1_props),
+    0,
+    0,
+    sizeof(struct MMC3_props)
+};
+
+static void (*mapperInit[NUM_MAPPERS])(Mapper*) =
+{
+    NULL,
+    mapper_MMC1_init,
+    NULL,
+    NULL,
+    mapper_MMC3_init
+};
+
+static void (*mapperScanline[NUM_MAPPERS])(Mapper*) =
+{
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    mapper_MMC3_scanline
 };
 
 Mapper mapper_apply (uint8_t header[], uint16_t const mapperID)
 {
-    Mapper mapper;
+    Mapper mapper = { 0 };
     mapper.props = NULL;
-/*
-    struct MMC1_properties * MMC1_props;
-
-    struct MapperBase * mapperProps[NUM_MAPPERS] = 
-    {
-        (struct MapperBase*) MMC1_props,
-        (struct MapperBase*) MMC1_props,
-        (struct MapperBase*) MMC1_props
-    };
-*/
+    mapper.propsSize = 0;
+    mapper.usesCHR = 0;
+    mapper.pageMap = NULL;
+    mapper.bankSelect = 0;
+    mapper.CHRdirty = 0;
     mapper.PRGbanks = header[4]; /* Total PRG 16KB banks */
     mapper.CHRbanks = header[5]; /* Total CHR 8KB banks */
 
-    printf("Mapper type %d, read %d PRG bank(s) and %d CHR bank(s). (%d KB and %d KB)\n", mapperID, 
-        mapper.PRGbanks, mapper.CHRbanks, 
-        mapper.PRGbanks * 16, mapper.CHRbanks * 8);
+    mapper.read = mapper_read;
 
     if (mapperID < NUM_MAPPERS)
     {
-        mapper.read  = mapperRead[mapperID];
         mapper.write = mapperWrite[mapperID];
+        mapper.map   = mapperMap[mapperID];
+        mapper.init  = mapperInit[mapperID];
+        mapper.scanline = mapperScanline[mapperID];
+
+        /* Freed when the rom is ejected */
+        mapper.propsSize = mapperPropsSize[mapperID];
+        if (mapper.propsSize)
+            mapper.props = calloc (1, mapper.propsSize);
+        if (!mapper.props)
+            mapper.propsSize = 0;
+        if (mapper.props && mapper.init)
+            mapper.init (&mapper);
     }
     else 
     {
         /* No appropriate mapper could be found, default to 0 (NROM), will likely have unintended effects */
-        mapper.read  = mapper_NROM_read;
         mapper.write = mapper_NROM_write;
+        mapper.map   = mapper_NROM_map;
     }
 
     return mapper;
 }
 
-/* NROM (mapper 0) */
+/* Bank windows. PRG windows also point the CPU pages they cover, so most
+   reads never reach the mapper at all */
 
-uint8_t mapper_NROM_read (Mapper * const mapper, uint16_t const address, uint8_t readCHR)
+void mapper_set_PRG (Mapper * const mapper, uint8_t const window, uint8_t const count, uint32_t const offset)
 {
-    if (readCHR) 
+    if (mapper->PRG->total == 0)
+        return;
+
+    for (int i = 0; i < count; i++)
     {
-        return mapper->CHR->data[address];
+        const uint8_t w = (window + i) & 3;
+        mapper->PRGwindow[w] = &mapper->PRG->data[(offset + i * PRG_WINDOW_SIZE) % mapper->PRG->total];
+
+        if (!mapper->pageMap) continue;
+        for (int page = 0; page < PRG_WINDOW_SIZE >> 8; page++)
+        {
+            mapper->pageMap[0x80 + (w << 5) + page] = mapper->PRGwindow[w] + (page << 8);
+        }
     }
-    /* Read PRG */
-    /* Choose from 16KB or 32KB in banks to read from. No write possible */
-    if (address >= 0x8000)
+}
+
+void mapper_set_CHR (Mapper * const mapper, uint8_t const window, uint8_t const count, uint32_t const offset)
+{
+    if (mapper->CHR->total == 0)
+        return;
+
+    for (int i = 0; i < count; i++)
     {
-        uint32_t mapped_addr = address & (mapper->PRGbanks > 1 ? 0x7fff : 0x3fff);
-        /* if (mapped_addr > 0x3fff) */
-        /* printf("NROM read: $%04x (%d size)\n", mapped_addr, mapper->PRG->total); */
-        return mapper->PRG->data[mapped_addr];
+        const uint8_t w = (window + i) & 7;
+        uint8_t * const bank = &mapper->CHR->data[(offset + i * CHR_WINDOW_SIZE) % mapper->CHR->total];
+
+        /* Decoded tiles are only dropped when what the PPU sees changes */
+        if (mapper->CHRwindow[w] != bank)
+        {
+            mapper->CHRwindow[w] = bank;
+            mapper->CHRdirty = 1;
+        }
     }
-    return 0;
 }
 
-void mapper_NROM_write (Mapper * const mapper, uint16_t const address, uint8_t const data, uint8_t writeCHR)
+void mapper_set_PRG_RAM (Mapper * const mapper, uint8_t * const ram)
 {
-    /* No mapping required. Assumes address is below 0x2000 */
-    if (writeCHR && mapper->CHRbanks == 0) 
-    {
-        mapper->CHR->data[address] = data;
+    if (!mapper->pageMap || !mapper->writeMap)
         return;
+
+    for (int page = 0; page < 0x20; page++)
+    {
+        mapper->pageMap[0x60 + page] = mapper->writeMap[0x60 + page] = ram ? ram + (page << 8) : NULL;
     }
 }
 
-/* MMC1 (mapper 1) */
+uint8_t mapper_read (Mapper * const mapper, uint16_t const address)
+{
+    /* Below $8000 is only PRG RAM, reached through the page tables when enabled */
+    if (address < 0x8000)
+        return 0;
 
-uint8_t mapper_MMC1_read (Mapper * mapper, uint16_t const address, uint8_t readCHR)
+    return mapper->PRGwindow[(address >> 13) & 3][address & 0x1fff];
+}
+
+/* NROM (mapper 0) */
+
+void mapper_NROM_write (Mapper * const mapper, uint16_t const address, uint8_t const data)
 {
-    return 0;
+    /* No registers */
 }
 
-void mapper_MMC1_write (Mapper * const mapper, uint16_t const address, uint8_t const data, uint8_t writeCHR)
+void mapper_NROM_map (Mapper * const mapper)
 {
-    return;
+    /* 16KB roms are mirrored into $c000 */
+    mapper_set_PRG (mapper, 0, 4, 0);
+    mapper_set_CHR (mapper, 0, 8, 0);
 }
 
-/* UxROM (mapper 2) */
+/* MMC1 (mapper 1) */
 
-uint8_t mapper_UxROM_read (Mapper * mapper, uint16_t const address, uint8_t readCHR)
+void mapper_MMC1_init (Mapper * const mapper)
 {
-    if (readCHR)
-	{
-		//return mapper_NROM_read (mapper, address, 1);
-        if (mapper->usesCHR) {
-            return mapper->localCHR.data[address];
-        } else {
-            return mapper->CHR->data[address];
-        }
-	}
+    struct MMC1_props * const MMC1 = mapper->props;
+
+    /* PRG mode 3, so the reset vector comes from the last bank */
+    MMC1->control.flags = 0x0c;
+    MMC1->shiftReg = 0x10;
+    MMC1->CHRbank[0] = MMC1->CHRbank[1] = 0;
+    MMC1->PRGbank = 0;
+}
+
+void mapper_MMC1_write (Mapper * const mapper, uint16_t const address, uint8_t const data)
+{
+    struct MMC1_props * const MMC1 = mapper->props;
 
-    /* Reading PRG */
     if (address < 0x8000) {
-        return 0;
+        return;
     }
 
-    uint32_t mapped_addr = 0;
+    /* Bit 7 clears the shift register and goes back to PRG mode 3 */
+    if (data & 0x80)
+    {
+        MMC1->shiftReg = 0x10;
+        MMC1->control.flags |= 0x0c;
+        mapper_MMC1_map (mapper);
+        return;
+    }
 
-    if (address < 0xc000) {
-        mapped_addr = ((address - 0x8000) & 0x3fff) | (mapper->bankSelect << 14);
-    } else {
-        mapped_addr = mapper->lastBankStart + (address & 0x3fff);
+    /* Serial load, low bit first. The marker bit reaching bit 0 means this is
+       the fifth write, which picks the register from address bits 13-14 */
+    const uint8_t full = MMC1->shiftReg & 1;
+    MMC1->shiftReg = (MMC1->shiftReg >> 1) | ((data & 1) << 4);
+    if (!full) {
+        return;
     }
 
-    return mapper->PRG->data[mapped_addr];
+    const uint8_t value = MMC1->shiftReg;
+    MMC1->shiftReg = 0x10;
+
+    switch ((address >> 13) & 3)
+    {
+        case 0: MMC1->control.flags = value; break;
+        case 1: MMC1->CHRbank[0] = value; break;
+        case 2: MMC1->CHRbank[1] = value; break;
+        case 3: MMC1->PRGbank = value; break;
+    }
+    mapper_MMC1_map (mapper);
 }
 
-void mapper_UxROM_write (Mapper * const mapper, uint16_t const address, uint8_t const data, uint8_t writeCHR) 
+void mapper_MMC1_map (Mapper * const mapper)
 {
-    if (writeCHR)
-	{
-        if (mapper->usesCHR) { // address < 0x2000) {
-            mapper->localCHR.data[address] = data;
-		    //mapper_NROM_write (mapper, address, data, 1);
-        }
-        return;
-	}
+    struct MMC1_props * const MMC1 = mapper->props;
+
+    static const uint8_t mirroring[4] = { MIRROR_SINGLE_LOW, MIRROR_SINGLE_HIGH, MIRROR_VERTICAL, MIRROR_HORIZONTAL };
+    mapper->mirroring = mirroring[MMC1->control.MIRRORING];
 
-    /* Write PRG */
+    /* 512KB boards take the top PRG address bit from the CHR bank register */
+    const uint32_t outer = (mapper->PRGbanks > 16) ? (MMC1->CHRbank[0] & 0x10) << 14 : 0;
+    const uint32_t bank  = outer | ((MMC1->PRGbank & 0xf) << 14);
+    const uint32_t last  = (mapper->PRGbanks > 16) ? outer | (0xf << 14) : mapper->lastBankStart;
+
+    switch (MMC1->control.PRG_BANK_MODE)
+    {
+        case 0:
+        case 1:
+            /* 32KB, low bit of the bank ignored */
+            mapper_set_PRG (mapper, 0, 4, bank & ~0x7fff);
+            break;
+        case 2:
+            /* First bank fixed at $8000, switch $c000 */
+            mapper_set_PRG (mapper, 0, 2, outer);
+            mapper_set_PRG (mapper, 2, 2, bank);
+            break;
+        case 3:
+            /* Switch $8000, last bank fixed at $c000 */
+            mapper_set_PRG (mapper, 0, 2, bank);
+            mapper_set_PRG (mapper, 2, 2, last);
+            break;
+    }
+
+    /* Two 4KB CHR banks, or one 8KB bank with the low bit ignored */
+    if (MMC1->control.CHR_BANK_MODE)
+    {
+        mapper_set_CHR (mapper, 0, 4, MMC1->CHRbank[0] << 12);
+        mapper_set_CHR (mapper, 4, 4, MMC1->CHRbank[1] << 12);
+    }
+    else
+        mapper_set_CHR (mapper, 0, 8, (MMC1->CHRbank[0] & 0x1e) << 12);
+
+    /* PRG bank bit 4 disables the 8KB of PRG RAM */
+    mapper_set_PRG_RAM (mapper, (MMC1->PRGbank & 0x10) ? NULL : MMC1->PRGram);
+}
+
+/* UxROM (mapper 2) */
+
+void mapper_UxROM_write (Mapper * const mapper, uint16_t const address, uint8_t const data) 
+{
     if (address < 0x8000) {
         return;
     }
 
+    /* Banks past the end of PRG mirror the ones before them */
     const uint8_t mask = 0xf;
-    mapper->bankSelect = data & mask;
+    mapper->bankSelect = (data & mask) % (mapper->PRGbanks ? mapper->PRGbanks : 1);
+    mapper_UxROM_map (mapper);
+}
+
+void mapper_UxROM_map (Mapper * const mapper)
+{
+    /* Switchable bank at $8000, last bank fixed at $c000 */
+    mapper_set_PRG (mapper, 0, 2, mapper->bankSelect << 14);
+    mapper_set_PRG (mapper, 2, 2, mapper->lastBankStart);
+    mapper_set_CHR (mapper, 0, 8, 0);
 }
 
-/* UxROM (mapper 3) */
+/* CNROM (mapper 3) */
 
-uint8_t mapper_CNROM_read (Mapper * const mapper, uint16_t const address, uint8_t readCHR)
+void mapper_CNROM_write (Mapper * const mapper, uint16_t const address, uint8_t const data)
 {
-    if (readCHR)
+    if (address >= 0x8000)
     {
-        uint32_t mapped_addr = (mapper->bankSelect << 13) + address;
-        return mapper->CHR->data[mapped_addr];
+        const uint8_t mask = 3;
+        mapper->bankSelect = (data & mask) % (mapper->CHRbanks ? mapper->CHRbanks : 1);
+        mapper_CNROM_map (mapper);
     }
-    
-    /* Read PRG */
-    return mapper_NROM_read (mapper, address, 0);
 }
 
-void mapper_CNROM_write (Mapper * const mapper, uint16_t const address, uint8_t const data, uint8_t writeCHR)
+void mapper_CNROM_map (Mapper * const mapper)
+{
+    /* Only CHR is switched, 8KB at a time */
+    mapper_set_PRG (mapper, 0, 4, 0);
+    mapper_set_CHR (mapper, 0, 8, mapper->bankSelect << 13);
+}
+
+/* MMC3 (mapper 4) */
+
+void mapper_MMC3_init (Mapper * const mapper)
 {
-    /* Write PRG */
-    if (!writeCHR && address >= 0x8000)
+    struct MMC3_props * const MMC3 = mapper->props;
+
+    /* Registers are undefined at power on, start from the same layout every time */
+    MMC3->bankSelect = 0;
+    for (int i = 0; i < 8; i++)
+        MMC3->bank[i] = (i < 6) ? 0 : i - 6;
+}
+
+/* Drive the IRQ line and tell the bus whether scanline clocks matter */
+
+static void mapper_MMC3_IRQ (Mapper * const mapper)
+{
+    struct MMC3_props * const MMC3 = mapper->props;
+
+    mapper->scanlineSync = MMC3->IRQenabled;
+    if (!mapper->IRQline) return;
+
+    if (MMC3->IRQasserted)
+        *mapper->IRQline |= IRQ_MAPPER;
+    else
+        *mapper->IRQline &= ~IRQ_MAPPER;
+}
+
+void mapper_MMC3_write (Mapper * const mapper, uint16_t const address, uint8_t const data)
+{
+    struct MMC3_props * const MMC3 = mapper->props;
+
+    if (address < 0x8000) {
+        return;
+    }
+
+    /* Register pairs at even and odd addresses of each 8KB range */
+    switch (address & 0xe001)
     {
-        const uint8_t mask = 3;
-        mapper->bankSelect = data & mask;
+        case 0x8000: MMC3->bankSelect = data; break;
+        case 0x8001: MMC3->bank[MMC3->bankSelect & 7] = data; break;
+        case 0xa000: MMC3->mirroring = data; break;
+
+        /* PRG RAM protect is kept but not applied, MMC6 boards use these bits differently */
+        case 0xa001: MMC3->PRGramProtect = data; return;
+
+        case 0xc000: MMC3->IRQlatch = data; return;
+        case 0xc001:
+            MMC3->IRQcounter = 0;
+            MMC3->IRQreload = 1;
+            return;
+
+        /* Disabling also acknowledges a pending IRQ */
+        case 0xe000:
+            MMC3->IRQenabled = MMC3->IRQasserted = 0;
+            mapper_MMC3_IRQ (mapper);
+            return;
+        case 0xe001:
+            MMC3->IRQenabled = 1;
+            mapper_MMC3_IRQ (mapper);
+            return;
     }
-}
\ No newline at end of file
+    mapper_MMC3_map (mapper);
+}
+
+void mapper_MMC3_map (Mapper * const mapper)
+{
+    struct MMC3_props * const MMC3 = mapper->props;
+    const uint8_t * const bank = MMC3->bank;
+    const uint32_t size = mapper->PRG->total;
+
+    /* PRG mode swaps the R6 window with the fixed second to last bank */
+    const uint8_t PRGswap = (MMC3->bankSelect & 0x40) ? 2 : 0;
+    mapper_set_PRG (mapper, 0 ^ PRGswap, 1, bank[6] << 13);
+    mapper_set_PRG (mapper, 1,           1, bank[7] << 13);
+    mapper_set_PRG (mapper, 2 ^ PRGswap, 1, size - 0x4000);
+    mapper_set_PRG (mapper, 3,           1, size - 0x2000);
+
+    /* Two 2KB and four 1KB CHR banks, inversion swaps the pattern table halves */
+    const uint8_t CHRswap = (MMC3->bankSelect & 0x80) ? 4 : 0;
+    mapper_set_CHR (mapper, 0 ^ CHRswap, 2, (bank[0] & 0xfe) << 10);
+    mapper_set_CHR (mapper, 2 ^ CHRswap, 2, (bank[1] & 0xfe) << 10);
+    for (int i = 0; i < 4; i++)
+    {
+        mapper_set_CHR (mapper, (4 + i) ^ CHRswap, 1, bank[2 + i] << 10);
+    }
+
+    /* Vertical or horizontal, unless the board is wired for four screen */
+    if (mapper->mirroring != MIRROR_FOUR_SCREEN)
+        mapper->mirroring = (MMC3->mirroring & 1) ? MIRROR_HORIZONTAL : MIRROR_VERTICAL;
+
+    mapper_set_PRG_RAM (mapper, MMC3->PRGram);
+    mapper_MMC3_IRQ (mapper);
+}
+
+void mapper_MMC3_scanline (Mapper * const mapper)
+{
+    struct MMC3_props * const MMC3 = mapper->props;
+
+    /* Reload when empty or asked to, otherwise count down */
+    if (MMC3->IRQcounter == 0 || MMC3->IRQreload)
+    {
+        MMC3->IRQcounter = MMC3->IRQlatch;
+        MMC3->IRQreload = 0;
+    }
+    else
+        MMC3->IRQcounter--;
+
+    if (MMC3->IRQcounter == 0 && MMC3->IRQenabled)
+    {
+        MMC3->IRQasserted = 1;
+        mapper_MMC3_IRQ (mapper);
+    }
+}
@@ -5,7 +5,26 @@
 #include "utils/v_array.h"
 #include "mapper_props.h"
 
-#define NUM_MAPPERS 4
+#define NUM_MAPPERS 5
+
+/* Bit of the bus IRQ line driven by the cartridge */
+#define IRQ_MAPPER 0x01
+
+/* Bank window sizes. PRG is switched in 8KB windows over $8000-$ffff and CHR
+   in 1KB windows over the pattern tables, larger banks take several windows */
+#define PRG_WINDOW_SIZE 0x2000
+#define CHR_WINDOW_SIZE 0x400
+
+/* Nametable mirroring, set from the header and changed by some mappers */
+
+enum mirroringType 
+{
+    MIRROR_HORIZONTAL  = 0,
+    MIRROR_VERTICAL    = 1,
+    MIRROR_SINGLE_LOW  = 2,
+    MIRROR_SINGLE_HIGH = 3,
+    MIRROR_FOUR_SCREEN = 4
+};
 
 /* Forward declaration and wrappers */
 
@@ -13,44 +32,104 @@ typedef struct Mapper_struct Mapper;
 
 typedef struct Mapper_struct
 {
-    /* Pointer to mapper-specific properties */
+    /* Pointer to mapper-specific properties, saved with the state */
     void   *props;
+    uint16_t propsSize;
 
     uint8_t PRGbanks;
     uint8_t CHRbanks;
     uint8_t bankSelect;
     uint32_t lastBankStart;
     uint8_t usesCHR;
+    uint8_t CHRdirty; /* Set when a bank switch changes the visible CHR */
+    uint8_t mirroring; /* Nametable mirroring the PPU should use, see mirroringType */
 
     /* Access to ROM data */
     struct VArray *PRG;
     struct VArray *CHR;
-    struct VArray localCHR;
 
-    /* Mapper is defined by its read/write implementations */
-    uint8_t (*read) (Mapper*, uint16_t const, uint8_t);
-    void    (*write)(Mapper*, uint16_t const, uint8_t const, uint8_t);
+    /* Bank windows, direct pointers into PRG and CHR. Mappers point these on
+       reset and bank switches, every access is then a shift and an index */
+    uint8_t *PRGwindow[4];
+    uint8_t *CHRwindow[8];
+
+    /* CPU page tables the mapper points at its PRG banks and PRG RAM, and
+       the IRQ line it drives, set by the bus */
+    uint8_t **pageMap;
+    uint8_t **writeMap;
+    uint8_t  *IRQline;
+
+    /* Set while a scanline clock may raise an IRQ, so the bus brings the PPU
+       up to date at every one instead of only at vertical blank */
+    uint8_t scanlineSync;
+
+    /* Mapper is defined by its CPU space read/write implementations and how
+       it points its windows. Pattern table accesses go through the windows */
+    uint8_t (*read) (Mapper*, uint16_t const);
+    void    (*write)(Mapper*, uint16_t const, uint8_t const);
+    void    (*map)  (Mapper*);
+
+    /* Sets power on register values in props, if the mapper has any */
+    void    (*init) (Mapper*);
+
+    /* Clocked by the PPU once per rendered line, where pattern address bit
+       A12 rises. NULL for mappers without a scanline counter */
+    void    (*scanline) (Mapper*);
 }
 Mapper;
 
-Mapper mapper_apply (uint8_t header[], uint16_t const mapperID);
+Mapper  mapper_apply   (uint8_t header[], uint16_t const mapperID);
 
-/* Concrete model read functions */
+/* Point count windows starting at window at the PRG or CHR data from a byte
+   offset. Offsets wrap around the data size, mirroring banks past the end */
+void    mapper_set_PRG (Mapper * const mapper, uint8_t const window, uint8_t const count, uint32_t const offset);
+void    mapper_set_CHR (Mapper * const mapper, uint8_t const window, uint8_t const count, uint32_t const offset);
 
-uint8_t mapper_NROM_read  (Mapper * mapper, uint16_t const address, uint8_t rw);
-uint8_t mapper_MMC1_read  (Mapper * mapper, uint16_t const address, uint8_t rw);
-uint8_t mapper_UxROM_read (Mapper * mapper, uint16_t const address, uint8_t rw);
-uint8_t mapper_CNROM_read (Mapper * mapper, uint16_t const address, uint8_t rw);
+/* Point $6000-$7fff at 8KB of PRG RAM, or unmap it with NULL */
+void    mapper_set_PRG_RAM (Mapper * const mapper, uint8_t * const ram);
 
-extern uint8_t (* mapperRead[NUM_MAPPERS])(Mapper*, uint16_t, uint8_t);
+/* Pattern table access through the CHR windows, only CHR RAM can be written */
+
+inline uint8_t mapper_CHR_read (Mapper * const mapper, uint16_t const address)
+{
+    return mapper->CHRwindow[(address >> 10) & 7][address & 0x3ff];
+}
+
+inline void mapper_CHR_write (Mapper * const mapper, uint16_t const address, uint8_t const data)
+{
+    if (mapper->usesCHR)
+        mapper->CHRwindow[(address >> 10) & 7][address & 0x3ff] = data;
+}
+
+/* Reads from the PRG windows, shared by every mapper */
+
+uint8_t mapper_read (Mapper * const mapper, uint16_t const address);
 
 /* Concrete model write functions */
 
-void mapper_NROM_write  (Mapper * mapper, uint16_t const address, uint8_t const data, uint8_t rw);
-void mapper_MMC1_write  (Mapper * mapper, uint16_t const address, uint8_t const data, uint8_t rw);
-void mapper_UxROM_write (Mapper * mapper, uint16_t const address, uint8_t const data, uint8_t rw);
-void mapper_CNROM_write (Mapper * mapper, uint16_t const address, uint8_t const data, uint8_t rw);
+void mapper_NROM_write  (Mapper * mapper, uint16_t const address, uint8_t const data);
+void mapper_MMC1_write  (Mapper * mapper, uint16_t const address, uint8_t const data);
+void mapper_UxROM_write (Mapper * mapper, uint16_t const address, uint8_t const data);
+void mapper_CNROM_write (Mapper * mapper, uint16_t const address, uint8_t const data);
+void mapper_MMC3_write  (Mapper * mapper, uint16_t const address, uint8_t const data);
+
+extern void (* mapperWrite[NUM_MAPPERS])(Mapper*, uint16_t, uint8_t);
+
+/* Concrete model window mapping functions, called on reset and bank switches */
+
+void mapper_NROM_map  (Mapper * mapper);
+void mapper_MMC1_map  (Mapper * mapper);
+void mapper_UxROM_map (Mapper * mapper);
+void mapper_CNROM_map (Mapper * mapper);
+void mapper_MMC3_map  (Mapper * mapper);
+
+extern void (* mapperMap[NUM_MAPPERS])(Mapper*);
+
+/* Mappers with registers kept in props */
+
+void mapper_MMC1_init (Mapper * mapper);
+void mapper_MMC3_init (Mapper * mapper);
 
-extern void (* mapperWrite[NUM_MAPPERS])(Mapper*, uint16_t, uint8_t, uint8_t);
+void mapper_MMC3_scanline (Mapper * mapper);
 
 #endif
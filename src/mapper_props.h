@@ -26,4 +26,20 @@ struct MMC1_props
     uint8_t PRGram[0x2000];
     uint8_t CHRbank[2];
     uint8_t PRGbank;
+};
+
+/* MMC3 unique props */
+
+struct MMC3_props
+{
+    uint8_t bankSelect;
+    uint8_t bank[8];
+    uint8_t mirroring;
+    uint8_t PRGramProtect;
+
+    /* Scanline counter */
+    uint8_t IRQlatch, IRQcounter;
+    uint8_t IRQreload, IRQenabled, IRQasserted;
+
+    uint8_t PRGram[0x2000];
 };
\ No newline at end of file
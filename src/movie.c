@@ -0,0 +1,271 @@
+#include <stdlib.h>
+#include <string.h>
+#include "bus.h"
+#include "state.h"
+#include "movie.h"
+
+#define MOVIE_HEADER_SIZE 24
+
+enum MovieRecord
+{
+    RECORD_INPUT = 0,
+    RECORD_RESET = 1
+};
+
+/* Bitwise CRC-32 (IEEE), only run once per movie */
+
+static uint32_t crc32_update (uint32_t crc, const uint8_t * data, size_t size)
+{
+    crc = ~crc;
+    while (size--)
+    {
+        crc ^= *data++;
+        for (uint8_t i = 0; i < 8; i++)
+            crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+    }
+    return ~crc;
+}
+
+uint32_t movie_rom_crc (Bus * const bus)
+{
+    NESrom * const rom = &bus->rom;
+    uint32_t crc = crc32_update (0, rom->PRGdata.data, rom->PRGdata.total);
+
+    /* CHR RAM is console state, not part of the cartridge */
+    if (!rom->mapper.usesCHR)
+        crc = crc32_update (crc, rom->CHRdata.data, rom->CHRdata.total);
+
+    return crc;
+}
+
+/* Record writing */
+
+static uint8_t * movie_reserve (Movie * const movie, size_t const bytes)
+{
+    if (movie->size + bytes > movie->capacity)
+    {
+        const size_t capacity = movie->capacity ? movie->capacity * 2 : 4096;
+        uint8_t * const data = realloc (movie->data, capacity);
+        if (!data) return NULL;
+
+        movie->data = data;
+        movie->capacity = capacity;
+    }
+    return movie->data + movie->size;
+}
+
+static void movie_flush_run (Movie * const movie)
+{
+    if (!movie->run) return;
+
+    /* Tag, two controllers and up to 5 bytes of frame count */
+    uint8_t * p = movie_reserve (movie, 8);
+    if (!p) return;
+
+    *p++ = RECORD_INPUT;
+    *p++ = movie->input[0];
+    *p++ = movie->input[1];
+
+    uint32_t run = movie->run;
+    while (run >= 0x80) {
+        *p++ = (run & 0x7f) | 0x80;
+        run >>= 7;
+    }
+    *p++ = run;
+
+    movie->size = p - movie->data;
+    movie->run = 0;
+}
+
+void movie_record_start (Movie * const movie, Bus * const bus, uint32_t const seed)
+{
+    movie->mode   = MOVIE_RECORD;
+    movie->romCRC = movie_rom_crc (bus);
+    movie->seed   = seed;
+    movie->frames = 0;
+    movie->size   = 0;
+    movie->run    = 0;
+
+    bus_power_on (bus, seed);
+}
+
+void movie_record_frame (Movie * const movie, Bus * const bus)
+{
+    if (movie->mode != MOVIE_RECORD) return;
+
+    if (movie->run && memcmp (movie->input, bus->controller, 2) == 0)
+    {
+        movie->run++;
+    }
+    else
+    {
+        movie_flush_run (movie);
+        memcpy (movie->input, bus->controller, 2);
+        movie->run = 1;
+    }
+    movie->frames++;
+}
+
+void movie_record_reset (Movie * const movie, Bus * const bus)
+{
+    if (movie->mode == MOVIE_RECORD)
+    {
+        movie_flush_run (movie);
+
+        uint8_t * const p = movie_reserve (movie, 1);
+        if (p)
+        {
+            *p = RECORD_RESET;
+            movie->size++;
+        }
+    }
+    bus_reset (bus);
+}
+
+/* Playback */
+
+uint8_t movie_play_start (Movie * const movie, Bus * const bus)
+{
+    movie_stop (movie);
+    if (movie->romCRC != movie_rom_crc (bus))
+        return 0;
+
+    movie->mode  = MOVIE_PLAY;
+    movie->pos   = 0;
+    movie->run   = 0;
+    movie->frame = 0;
+
+    bus_power_on (bus, movie->seed);
+    return 1;
+}
+
+uint8_t movie_play_frame (Movie * const movie, Bus * const bus)
+{
+    if (movie->mode != MOVIE_PLAY) return 0;
+
+    while (!movie->run)
+    {
+        const uint8_t * p   = movie->data + movie->pos;
+        const uint8_t * end = movie->data + movie->size;
+
+        if (p < end && *p == RECORD_RESET)
+        {
+            bus_reset (bus);
+            movie->pos++;
+            continue;
+        }
+
+        /* Input run, anything else ends the movie */
+        if (end - p < 4 || *p != RECORD_INPUT)
+        {
+            movie->mode = MOVIE_IDLE;
+            return 0;
+        }
+        movie->input[0] = p[1];
+        movie->input[1] = p[2];
+        p += 3;
+
+        uint32_t run = 0;
+        uint8_t shift = 0;
+        while (p < end && shift < 35)
+        {
+            run |= (uint32_t)(*p & 0x7f) << shift;
+            shift += 7;
+            if (!(*p++ & 0x80)) break;
+        }
+        movie->run = run;
+        movie->pos = p - movie->data;
+    }
+
+    memcpy (bus->controller, movie->input, 2);
+    movie->run--;
+    movie->frame++;
+    return 1;
+}
+
+void movie_stop (Movie * const movie)
+{
+    if (movie->mode == MOVIE_RECORD)
+        movie_flush_run (movie);
+
+    movie->mode = MOVIE_IDLE;
+    movie->run = 0;
+}
+
+void movie_free (Movie * const movie)
+{
+    free (movie->data);
+    *movie = (Movie){ 0 };
+}
+
+/* Files */
+
+static uint8_t * put32 (uint8_t * p, uint32_t const value)
+{
+    p[0] = value;
+    p[1] = value >> 8;
+    p[2] = value >> 16;
+    p[3] = value >> 24;
+    return p + 4;
+}
+
+static uint32_t get32 (const uint8_t * const p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+uint8_t movie_save (Movie * const movie, const char * const path)
+{
+    if (movie->mode == MOVIE_RECORD)
+        movie_flush_run (movie);
+
+    uint8_t header[MOVIE_HEADER_SIZE] = { 'N', 'S', 'M', 'V', MOVIE_VERSION, 0, 0, 0 };
+    uint8_t * p = header + 8;
+    p = put32 (p, movie->romCRC);
+    p = put32 (p, movie->seed);
+    p = put32 (p, movie->frames);
+    p = put32 (p, 0);
+
+    FILE * f = fopen (path, "wb");
+    if (!f) return 0;
+
+    const uint8_t written =
+        fwrite (header, 1, sizeof(header), f) == sizeof(header) &&
+        fwrite (movie->data, 1, movie->size, f) == movie->size;
+
+    return (fclose (f) == 0) && written;
+}
+
+uint8_t movie_load (Movie * const movie, const uint8_t * const data, size_t const size)
+{
+    if (size < MOVIE_HEADER_SIZE || memcmp (data, "NSMV", 4) != 0 ||
+        (data[4] | (data[5] << 8)) > MOVIE_VERSION)
+        return 0;
+
+    uint8_t * const records = malloc (size - MOVIE_HEADER_SIZE + 1);
+    if (!records) return 0;
+
+    free (movie->data);
+    *movie = (Movie){ 0 };
+    movie->romCRC   = get32 (data + 8);
+    movie->seed     = get32 (data + 12);
+    movie->frames   = get32 (data + 16);
+    movie->data     = records;
+    movie->size     = size - MOVIE_HEADER_SIZE;
+    movie->capacity = movie->size + 1;
+    memcpy (records, data + MOVIE_HEADER_SIZE, movie->size);
+
+    return 1;
+}
+
+uint8_t movie_load_file (Movie * const movie, const char * const path)
+{
+    size_t size = 0;
+    uint8_t * const data = (uint8_t*)read_file (path, &size);
+    if (!data) return 0;
+
+    const uint8_t loaded = movie_load (movie, data, size);
+    free (data);
+
+    return loaded;
+}
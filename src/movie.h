@@ -0,0 +1,74 @@
+#ifndef MOVIE_H
+#define MOVIE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Input movies. A movie holds the controller bytes for every frame from power
+   on, so playing it back repeats a run exactly. The file is a 24 byte header
+   ("NSMV", 16 bit version and reserved word, then 32 bit little endian ROM
+   CRC, RAM seed, frame count and a reserved word) followed by records:
+
+   0x00 port0 port1 frames   both controllers held for a number of frames
+   0x01                      console reset before the next frame
+
+   Frame counts are stored 7 bits at a time, low bits first */
+
+#define MOVIE_VERSION 1
+
+typedef struct Bus_struct Bus;
+
+enum MovieMode
+{
+    MOVIE_IDLE,
+    MOVIE_RECORD,
+    MOVIE_PLAY
+};
+
+typedef struct Movie_struct
+{
+    uint8_t  mode;
+    uint32_t romCRC, seed, frames;
+
+    /* Encoded records */
+    uint8_t * data;
+    size_t size, capacity;
+
+    /* Input run being recorded, or left to play back */
+    uint8_t  input[2];
+    uint32_t run;
+    size_t   pos;
+    uint32_t frame;
+}
+Movie;
+
+/* CRC-32 of the PRG and CHR ROM data of the loaded cartridge */
+uint32_t movie_rom_crc (Bus * const bus);
+
+/* Power on the console with seed and start recording */
+void    movie_record_start (Movie * const, Bus * const bus, uint32_t const seed);
+
+/* Log the controllers for the frame about to run */
+void    movie_record_frame (Movie * const, Bus * const bus);
+
+/* Reset the console and log it */
+void    movie_record_reset (Movie * const, Bus * const bus);
+
+/* Power on the console as the movie was recorded and start playback.
+   Returns 0 if the movie was made with a different ROM */
+uint8_t movie_play_start   (Movie * const, Bus * const bus);
+
+/* Set the controllers for the frame about to run, applying any reset first.
+   Returns 0 once the movie has ended */
+uint8_t movie_play_frame   (Movie * const, Bus * const bus);
+
+/* Finish recording or playback, the movie is kept for saving */
+void    movie_stop (Movie * const);
+void    movie_free (Movie * const);
+
+/* Movie files. These return 0 on failure, loading leaves the movie idle */
+uint8_t movie_save      (Movie * const, const char * const path);
+uint8_t movie_load      (Movie * const, const uint8_t * const data, size_t const size);
+uint8_t movie_load_file (Movie * const, const char * const path);
+
+#endif
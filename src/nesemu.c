@@ -0,0 +1,108 @@
+#include <stdlib.h>
+#include "bus.h"
+#include "state.h"
+#include "nesemu.h"
+
+/* External definitions of the header inline functions, so the library links
+   whether or not a client's compiler inlined them */
+
+extern inline void     bus_reset         (Bus * const bus);
+extern inline void     bus_step          (Bus * const bus);
+extern inline void     bus_exec          (Bus * const bus, uint32_t const tickcount);
+extern inline void     bus_cpu_tick      (Bus * const bus);
+extern inline void     bus_scanline_step (Bus * const bus);
+
+extern inline void     vc_init       (struct VArray* const v, uint32_t initialSize);
+extern inline void     vc_resize     (struct VArray* const v, int const capacity);
+extern inline void     vc_push       (struct VArray* const v, uint8_t const element);
+extern inline void     vc_push_array (struct VArray* const v, uint8_t* elements, uint32_t count, uint32_t start);
+extern inline uint8_t  vc_get        (struct VArray* v, int32_t index);
+extern inline uint32_t vc_size       (struct VArray* const v);
+extern inline void     vc_free       (struct VArray* const v);
+
+extern inline char*    read_file       (const char* filename, size_t* fileSize);
+extern inline char*    read_file_short (const char* filename);
+
+/* CPU cycles run per frame, a little over one NTSC frame */
+#define FRAME_CYCLES 29829
+
+NESemu * nesemu_create (void)
+{
+    Bus * const bus = calloc (1, sizeof(Bus));
+    if (bus)
+        bus_reset (bus);
+
+    return bus;
+}
+
+void nesemu_destroy (NESemu * const bus)
+{
+    if (!bus) return;
+
+    ppu_debug_free (&bus->ppu);
+    rom_eject (&bus->rom);
+    free (bus);
+}
+
+uint8_t nesemu_load_rom (NESemu * const bus, const uint8_t * const data, size_t const size)
+{
+    return rom_load_memory (bus, data, size, NULL);
+}
+
+uint8_t nesemu_load_file (NESemu * const bus, const char * const path)
+{
+    return rom_load (bus, path);
+}
+
+void nesemu_reset (NESemu * const bus)
+{
+    bus_reset (bus);
+}
+
+void nesemu_power_on (NESemu * const bus, uint32_t const seed)
+{
+    bus_power_on (bus, seed);
+}
+
+void nesemu_set_verbose (NESemu * const bus, uint8_t const verbose)
+{
+    bus->rom.verbose = verbose;
+}
+
+void nesemu_set_input (NESemu * const bus, uint8_t const port, uint8_t const buttons)
+{
+    bus->controller[port & 1] = buttons;
+}
+
+void nesemu_run_frame (NESemu * const bus)
+{
+    bus_exec (bus, FRAME_CYCLES);
+}
+
+const uint8_t * nesemu_frame (NESemu * const bus, const uint8_t ** emphasis)
+{
+    if (emphasis)
+        *emphasis = bus->ppu.emphasis;
+
+    return bus->ppu.frameBuffer;
+}
+
+void nesemu_frame_pixels (NESemu * const bus, enum PixelFormat const format, void * const dest)
+{
+    palette_convert (bus->ppu.frameBuffer, bus->ppu.emphasis, NESEMU_HEIGHT, format, dest);
+}
+
+size_t nesemu_state_size (NESemu * const bus)
+{
+    return bus_state_size (bus);
+}
+
+size_t nesemu_save_state (NESemu * const bus, uint8_t * const buf)
+{
+    return bus_save_state (bus, buf);
+}
+
+uint8_t nesemu_load_state (NESemu * const bus, const uint8_t * const buf, size_t const size)
+{
+    return bus_load_state (bus, buf, size);
+}
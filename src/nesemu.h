@@ -0,0 +1,64 @@
+#ifndef NESEMU_H
+#define NESEMU_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "palette.h"
+
+/* Core library API. Everything needed to run a console without a window,
+   built as libnesemu by `make lib`. The console handle is opaque to clients,
+   the GUI includes bus.h directly for its debug views */
+
+#define NESEMU_WIDTH  256
+#define NESEMU_HEIGHT 240
+
+/* Controller bits, as read back by the game */
+
+#define NESEMU_BUTTON_A      0x80
+#define NESEMU_BUTTON_B      0x40
+#define NESEMU_BUTTON_SELECT 0x20
+#define NESEMU_BUTTON_START  0x10
+#define NESEMU_BUTTON_UP     0x08
+#define NESEMU_BUTTON_DOWN   0x04
+#define NESEMU_BUTTON_LEFT   0x02
+#define NESEMU_BUTTON_RIGHT  0x01
+
+typedef struct Bus_struct NESemu;
+
+NESemu * nesemu_create  (void);
+void     nesemu_destroy (NESemu * const emu);
+
+/* Load an iNES image from memory or a file, the console is reset after.
+   Returns 0 and keeps the current cartridge if the image is invalid */
+uint8_t  nesemu_load_rom  (NESemu * const emu, const uint8_t * const data, size_t const size);
+uint8_t  nesemu_load_file (NESemu * const emu, const char * const path);
+
+void     nesemu_reset     (NESemu * const emu);
+
+/* Power cycle with the loaded cartridge. RAM is filled from seed, and
+   cleared for seed 0, so runs from power on repeat exactly */
+void     nesemu_power_on  (NESemu * const emu, uint32_t const seed);
+
+/* Print cartridge details to stderr on every load. Off by default, errors
+   such as an unreadable file are always printed */
+void     nesemu_set_verbose (NESemu * const emu, uint8_t const verbose);
+
+/* Set the buttons held on controller port 0 or 1 */
+void     nesemu_set_input (NESemu * const emu, uint8_t const port, uint8_t const buttons);
+
+/* Run the CPU for one frame's worth of cycles */
+void     nesemu_run_frame (NESemu * const emu);
+
+/* The last frame as 6-bit palette indexes, NESEMU_WIDTH * NESEMU_HEIGHT bytes.
+   The color emphasis bits of each line are returned through emphasis */
+const uint8_t * nesemu_frame (NESemu * const emu, const uint8_t ** emphasis);
+
+/* The last frame converted to packed pixels, see palette_pixel_size */
+void     nesemu_frame_pixels (NESemu * const emu, enum PixelFormat const format, void * const dest);
+
+/* Save states, see state.h */
+size_t   nesemu_state_size (NESemu * const emu);
+size_t   nesemu_save_state (NESemu * const emu, uint8_t * const buf);
+uint8_t  nesemu_load_state (NESemu * const emu, const uint8_t * const buf, size_t const size);
+
+#endif
@@ -1,9 +1,287 @@
+#include <string.h>
 #include "palette.h"
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PALETTE_SIMD
+#include <immintrin.h>
+#endif
+
+extern inline uint8_t palette_pixel_size (enum PixelFormat const format);
+
 const uint16_t palette2C03[64] = 
 {
     0x333, 0x014, 0x006, 0x326, 0x403, 0x503, 0x400, 0x420, 0x320, 0x120, 0x031, 0x040, 0x022, 0,     0, 0,
     0x555, 0x036, 0x027, 0x407, 0x507, 0x704, 0x620, 0x630, 0x430, 0x140, 0x040, 0x053, 0x044, 0,     0, 0,
     0x777, 0x357, 0x447, 0x637, 0x707, 0x737, 0x743, 0x750, 0x660, 0x360, 0x070, 0x276, 0x077, 0x222, 0, 0,
     0x777, 0x567, 0x657, 0x767, 0x747, 0x755, 0x764, 0x772, 0x773, 0x572, 0x473, 0x276, 0x467, 0x555, 0, 0
-};
\ No newline at end of file
+};
+
+/* Lookup table for one set of emphasis bits. Each entry holds one pixel in
+   the output byte order, and the planes hold byte N of every entry for the
+   shuffle kernels, which look up 16 palette indexes at a time */
+
+typedef struct PaletteLUT_struct
+{
+    uint8_t pixel[64][4];
+    uint8_t plane[4][64];
+}
+PaletteLUT;
+
+typedef void (*PaletteRowFn)(uint8_t const * indexes, PaletteLUT const * lut, uint8_t size, uint8_t * out);
+
+/* Fill a lookup table for one set of emphasis bits. The RGB PPU drives an
+   emphasized channel at full strength instead of dimming the other two */
+
+static void palette_build (uint8_t const emphasis, enum PixelFormat const format, PaletteLUT * const lut)
+{
+    for (int i = 0; i < 64; i++)
+    {
+        const uint16_t color = palette2C03[i];
+        const uint8_t r = (emphasis & 1) ? 0xe0 : (uint8_t)(color >> 8) << 5;
+        const uint8_t g = (emphasis & 2) ? 0xe0 : (uint8_t)(color >> 4) << 5;
+        const uint8_t b = (emphasis & 4) ? 0xe0 : (uint8_t)(color << 5);
+        uint8_t * const pixel = lut->pixel[i];
+
+        if (format == PIXEL_RGB565)
+        {
+            const uint16_t packed = ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3);
+            memcpy (pixel, &packed, 2);
+            pixel[2] = pixel[3] = 0;
+        }
+        else
+        {
+            pixel[0] = (format == PIXEL_BGRA32) ? b : r;
+            pixel[1] = g;
+            pixel[2] = (format == PIXEL_BGRA32) ? r : b;
+            pixel[3] = 0xff;
+        }
+        for (int byte = 0; byte < 4; byte++)
+        {
+            lut->plane[byte][i] = pixel[byte];
+        }
+    }
+}
+
+/* Scalar fallback, converts one row of 256 pixels */
+
+static void palette_row (uint8_t const * indexes, PaletteLUT const * lut, uint8_t size, uint8_t * out)
+{
+    switch (size)
+    {
+        case 2:
+            for (int x = 0; x < 256; x++, out += 2)
+                memcpy (out, lut->pixel[*indexes++ & 0x3f], 2);
+            break;
+        case 3:
+            for (int x = 0; x < 256; x++, out += 3)
+                memcpy (out, lut->pixel[*indexes++ & 0x3f], 3);
+            break;
+        case 4:
+            for (int x = 0; x < 256; x++, out += 4)
+                memcpy (out, lut->pixel[*indexes++ & 0x3f], 4);
+            break;
+    }
+}
+
+#ifdef PALETTE_SIMD
+
+/* Shuffle kernels. The low 4 bits of an index pick a byte from a 16 byte
+   slice of a plane. For each slice the index is rebased so that a saturating
+   add sets the top bit (which makes the shuffle write zero) on indexes outside
+   of it, then the four slices are merged */
+
+#define PALETTE_SELECT(MM, SI, index, slice)                                   \
+    MM##_adds_epu8 (MM##_xor_si##SI (index, MM##_set1_epi8 ((slice) << 4)),      \
+                    MM##_set1_epi8 (0x70))
+
+#define PALETTE_SHUFFLE(MM, SI, plane, select)                                  \
+    MM##_or_si##SI (                                                            \
+        MM##_or_si##SI (MM##_shuffle_epi8 (plane[0], select[0]),                \
+                        MM##_shuffle_epi8 (plane[1], select[1])),               \
+        MM##_or_si##SI (MM##_shuffle_epi8 (plane[2], select[2]),                \
+                        MM##_shuffle_epi8 (plane[3], select[3])))
+
+/* RGB24 interleave. Output vector k takes, for each of its 16 bytes, a pixel
+   from the plane of that byte's channel, -1 leaves the byte for another plane */
+
+static const int8_t rgb24Interleave[3][3][16] =
+{
+    {
+        {  0, -1, -1,  1, -1, -1,  2, -1, -1,  3, -1, -1,  4, -1, -1,  5 },
+        { -1,  0, -1, -1,  1, -1, -1,  2, -1, -1,  3, -1, -1,  4, -1, -1 },
+        { -1, -1,  0, -1, -1,  1, -1, -1,  2, -1, -1,  3, -1, -1,  4, -1 }
+    },
+    {
+        { -1, -1,  6, -1, -1,  7, -1, -1,  8, -1, -1,  9, -1, -1, 10, -1 },
+        {  5, -1, -1,  6, -1, -1,  7, -1, -1,  8, -1, -1,  9, -1, -1, 10 },
+        { -1,  5, -1, -1,  6, -1, -1,  7, -1, -1,  8, -1, -1,  9, -1, -1 }
+    },
+    {
+        { -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1, -1 },
+        { -1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1 },
+        { 10, -1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15 }
+    }
+};
+
+/* Store 16 RGB24 pixels from their R, G and B bytes */
+
+__attribute__((target("ssse3")))
+static inline void palette_store_rgb24 (uint8_t * const out, __m128i const r, __m128i const g, __m128i const b)
+{
+    for (int k = 0; k < 3; k++)
+    {
+        const __m128i * const mask = (__m128i const *)rgb24Interleave[k];
+        _mm_storeu_si128 ((__m128i *)out + k, _mm_or_si128 (
+            _mm_or_si128 (_mm_shuffle_epi8 (r, _mm_loadu_si128 (mask)),
+                          _mm_shuffle_epi8 (g, _mm_loadu_si128 (mask + 1))),
+            _mm_shuffle_epi8 (b, _mm_loadu_si128 (mask + 2))));
+    }
+}
+
+__attribute__((target("ssse3")))
+static void palette_row_ssse3 (uint8_t const * indexes, PaletteLUT const * lut, uint8_t size, uint8_t * out)
+{
+    __m128i plane[4][4];
+    for (int byte = 0; byte < size; byte++)
+        for (int slice = 0; slice < 4; slice++)
+            plane[byte][slice] = _mm_loadu_si128 ((__m128i const *)&lut->plane[byte][slice * 16]);
+
+    for (int x = 0; x < 256; x += 16)
+    {
+        const __m128i index = _mm_and_si128 (_mm_loadu_si128 ((__m128i const *)(indexes + x)), _mm_set1_epi8 (0x3f));
+        const __m128i select[4] = {
+            PALETTE_SELECT (_mm, 128, index, 0), PALETTE_SELECT (_mm, 128, index, 1),
+            PALETTE_SELECT (_mm, 128, index, 2), PALETTE_SELECT (_mm, 128, index, 3)
+        };
+        const __m128i b0 = PALETTE_SHUFFLE (_mm, 128, plane[0], select);
+        const __m128i b1 = PALETTE_SHUFFLE (_mm, 128, plane[1], select);
+
+        if (size == 2)
+        {
+            _mm_storeu_si128 ((__m128i *)out,     _mm_unpacklo_epi8 (b0, b1));
+            _mm_storeu_si128 ((__m128i *)out + 1, _mm_unpackhi_epi8 (b0, b1));
+            out += 32;
+        }
+        else if (size == 3)
+        {
+            palette_store_rgb24 (out, b0, b1, PALETTE_SHUFFLE (_mm, 128, plane[2], select));
+            out += 48;
+        }
+        else
+        {
+            const __m128i b2 = PALETTE_SHUFFLE (_mm, 128, plane[2], select);
+            const __m128i b3 = PALETTE_SHUFFLE (_mm, 128, plane[3], select);
+            const __m128i lo01 = _mm_unpacklo_epi8 (b0, b1);
+            const __m128i hi01 = _mm_unpackhi_epi8 (b0, b1);
+            const __m128i lo23 = _mm_unpacklo_epi8 (b2, b3);
+            const __m128i hi23 = _mm_unpackhi_epi8 (b2, b3);
+
+            _mm_storeu_si128 ((__m128i *)out,     _mm_unpacklo_epi16 (lo01, lo23));
+            _mm_storeu_si128 ((__m128i *)out + 1, _mm_unpackhi_epi16 (lo01, lo23));
+            _mm_storeu_si128 ((__m128i *)out + 2, _mm_unpacklo_epi16 (hi01, hi23));
+            _mm_storeu_si128 ((__m128i *)out + 3, _mm_unpackhi_epi16 (hi01, hi23));
+            out += 64;
+        }
+    }
+}
+
+/* Same as above 32 pixels at a time. Shuffles and unpacks stay within each
+   128 bit lane, so the halves are put back in order when storing */
+
+__attribute__((target("avx2")))
+static void palette_row_avx2 (uint8_t const * indexes, PaletteLUT const * lut, uint8_t size, uint8_t * out)
+{
+    __m256i plane[4][4];
+    for (int byte = 0; byte < size; byte++)
+        for (int slice = 0; slice < 4; slice++)
+            plane[byte][slice] = _mm256_broadcastsi128_si256 (
+                _mm_loadu_si128 ((__m128i const *)&lut->plane[byte][slice * 16]));
+
+    for (int x = 0; x < 256; x += 32)
+    {
+        const __m256i index = _mm256_and_si256 (_mm256_loadu_si256 ((__m256i const *)(indexes + x)), _mm256_set1_epi8 (0x3f));
+        const __m256i select[4] = {
+            PALETTE_SELECT (_mm256, 256, index, 0), PALETTE_SELECT (_mm256, 256, index, 1),
+            PALETTE_SELECT (_mm256, 256, index, 2), PALETTE_SELECT (_mm256, 256, index, 3)
+        };
+        const __m256i b0 = PALETTE_SHUFFLE (_mm256, 256, plane[0], select);
+        const __m256i b1 = PALETTE_SHUFFLE (_mm256, 256, plane[1], select);
+
+        if (size == 2)
+        {
+            const __m256i lo = _mm256_unpacklo_epi8 (b0, b1);
+            const __m256i hi = _mm256_unpackhi_epi8 (b0, b1);
+
+            _mm256_storeu_si256 ((__m256i *)out,     _mm256_permute2x128_si256 (lo, hi, 0x20));
+            _mm256_storeu_si256 ((__m256i *)out + 1, _mm256_permute2x128_si256 (lo, hi, 0x31));
+            out += 64;
+        }
+        else if (size == 3)
+        {
+            /* Each lane holds 16 whole pixels, interleaved one lane at a time */
+            const __m256i b2 = PALETTE_SHUFFLE (_mm256, 256, plane[2], select);
+
+            palette_store_rgb24 (out, _mm256_castsi256_si128 (b0), _mm256_castsi256_si128 (b1),
+                _mm256_castsi256_si128 (b2));
+            palette_store_rgb24 (out + 48, _mm256_extracti128_si256 (b0, 1), _mm256_extracti128_si256 (b1, 1),
+                _mm256_extracti128_si256 (b2, 1));
+            out += 96;
+        }
+        else
+        {
+            const __m256i b2 = PALETTE_SHUFFLE (_mm256, 256, plane[2], select);
+            const __m256i b3 = PALETTE_SHUFFLE (_mm256, 256, plane[3], select);
+            const __m256i lo01 = _mm256_unpacklo_epi8 (b0, b1);
+            const __m256i hi01 = _mm256_unpackhi_epi8 (b0, b1);
+            const __m256i lo23 = _mm256_unpacklo_epi8 (b2, b3);
+            const __m256i hi23 = _mm256_unpackhi_epi8 (b2, b3);
+            const __m256i p0 = _mm256_unpacklo_epi16 (lo01, lo23);
+            const __m256i p1 = _mm256_unpackhi_epi16 (lo01, lo23);
+            const __m256i p2 = _mm256_unpacklo_epi16 (hi01, hi23);
+            const __m256i p3 = _mm256_unpackhi_epi16 (hi01, hi23);
+
+            _mm256_storeu_si256 ((__m256i *)out,     _mm256_permute2x128_si256 (p0, p1, 0x20));
+            _mm256_storeu_si256 ((__m256i *)out + 1, _mm256_permute2x128_si256 (p2, p3, 0x20));
+            _mm256_storeu_si256 ((__m256i *)out + 2, _mm256_permute2x128_si256 (p0, p1, 0x31));
+            _mm256_storeu_si256 ((__m256i *)out + 3, _mm256_permute2x128_si256 (p2, p3, 0x31));
+            out += 128;
+        }
+    }
+}
+
+#endif
+
+/* Pick the fastest row kernel the running CPU supports. Kernels handle every
+   format, given its pixel size and lookup table */
+
+static PaletteRowFn palette_select (void)
+{
+#ifdef PALETTE_SIMD
+    if (__builtin_cpu_supports ("avx2"))  return palette_row_avx2;
+    if (__builtin_cpu_supports ("ssse3")) return palette_row_ssse3;
+#endif
+    return palette_row;
+}
+
+void palette_convert (
+    uint8_t const * indexes, uint8_t const * emphasis, uint16_t const rows,
+    enum PixelFormat const format, void * const dest)
+{
+    PaletteLUT lut;
+    uint8_t current = 0xff;
+
+    const PaletteRowFn convert_row = palette_select ();
+    const uint8_t size = palette_pixel_size (format);
+    uint8_t * out = dest;
+
+    for (uint16_t y = 0; y < rows; y++, indexes += 256, out += 256 * size)
+    {
+        /* Emphasis rarely changes within a frame, so rebuild only when it does */
+        if ((emphasis[y] & 7) != current)
+        {
+            current = emphasis[y] & 7;
+            palette_build (current, format, &lut);
+        }
+        convert_row (indexes, &lut, size, out);
+    }
+}
\ No newline at end of file
@@ -5,4 +5,28 @@
 
 extern const uint16_t palette2C03[64];
 
+/* Output formats for converting the PPU's indexed frame */
+
+enum PixelFormat
+{
+    PIXEL_RGB24,
+    PIXEL_RGBA32,
+    PIXEL_BGRA32,
+    PIXEL_RGB565
+};
+
+/* Number of bytes one pixel takes in a given format */
+
+inline uint8_t palette_pixel_size (enum PixelFormat const format)
+{
+    return (format == PIXEL_RGB565) ? 2 : (format == PIXEL_RGB24) ? 3 : 4;
+}
+
+/* Convert 6-bit palette indexes to packed pixels. Each row of 256 pixels
+   uses the color emphasis bits (BGR, as in PPU_MASK bits 5-7) given for it */
+
+void palette_convert (
+    uint8_t const * indexes, uint8_t const * emphasis, uint16_t const rows,
+    enum PixelFormat const format, void * const dest);
+
 #endif
@@ -1,8 +1,12 @@
+#include <stdlib.h>
 #include <string.h>
 #include "ppu2c02.h"
 #include "palette.h"
 #include "rom.h"
 
+extern inline uint8_t ppu_show_debug   (PPU2C02 * const ppu);
+extern inline void    ppu_toggle_debug (PPU2C02 * const ppu);
+
 void ppu_reset (PPU2C02 * const ppu, NESrom * const rom)
 {
 	ppu->control.flags = 0;
@@ -10,6 +14,7 @@ void ppu_reset (PPU2C02 * const ppu, NESrom * const rom)
 	ppu->status.flags = 0;
 
 	ppu->scanline = ppu->cycle = ppu->frame = 0;
+	ppu->clockCount = ppu->clockGoal = 0;
 	ppu->latch = 0;
 	ppu->fineX = 0;
 	ppu->dataBuffer = 0;
@@ -17,20 +22,16 @@ void ppu_reset (PPU2C02 * const ppu, NESrom * const rom)
 	ppu->bg_shifter_pattern_lo = ppu->bg_shifter_pattern_hi = 0;
 	ppu->VRam.reg = ppu->tmpVRam.reg = 0x0;
 
-	memset(&ppu->nameTables, 0, 2048);
-	memset(&ppu->VRamData, 0, 8192);
-
-	/* Copy the first 8K of CHR data as needed for mapper 0 */
+	memset(&ppu->nameTables, 0, sizeof(ppu->nameTables));
+	memset(&ppu->tileValid, 0, sizeof(ppu->tileValid));
 
-	ppu->mirroring = rom->mirroring;
+	ppu_set_mirroring (ppu, rom->mapper.mirroring);
 	ppu->mapper    = &rom->mapper;
+	ppu_schedule (ppu);
 
-	if (rom->CHRdata.total && rom->mapperID == 0)
-	{
-		memcpy(ppu->VRamData, rom->CHRdata.data, rom->CHRdata.total);
-        copy_pattern_table (ppu, 0);
-        copy_pattern_table (ppu, 1);
-	}
+	/* A new ROM means the debug images are out of date */
+	if (ppu->debugView)
+		ppu->debugView->valid = 0;
 }
 
 /* Read PPU register address */
@@ -52,12 +53,13 @@ uint8_t ppu_register_read (PPU2C02 * const ppu, uint16_t const address)
 			data = ppu->OAMdata[ppu->OAMaddress];
 			break;
 		case PPU_DATA:
-			/* Reads here are delayed, retrieve from the buffer */
+			/* Reads here are delayed, retrieve from the buffer. The PPU
+			   address bus is 14 bits wide, fine Y may be in the top bits */
 			data = ppu->dataBuffer;
-			ppu->dataBuffer = ppu_read(ppu, ppu->VRam.reg);
+			ppu->dataBuffer = ppu_read(ppu, ppu->VRam.reg & 0x3fff);
 
 			/* Fetch immediately if address is palette data */
-			if (ppu->VRam.reg >= 0x3f00) 
+			if ((ppu->VRam.reg & 0x3fff) >= 0x3f00) 
 				data = ppu->dataBuffer;
 
 			ppu->VRam.reg += (ppu->control.VRAM_ADD_INCREMENT) ? 32 : 1;
@@ -89,7 +91,10 @@ void ppu_register_write (PPU2C02 * const ppu, uint16_t const address, uint8_t co
 			ppu->control.flags = data;
 			//ppu->tmpVRam.nametableX = ppu->control.NAMETABLE_1;
 			//ppu->tmpVRam.nametableY = ppu->control.NAMETABLE_2;
-			ppu->tmpVRam.reg |= (data & 3) << 10;
+			ppu->tmpVRam.reg = (ppu->tmpVRam.reg & ~0xc00) | ((data & 3) << 10);
+
+			/* Pattern table selection moves the scanline clock */
+			ppu_schedule (ppu);
 			break;
 		case PPU_MASK:    /* $2001 */
 			ppu->mask.flags = data;
@@ -100,7 +105,7 @@ void ppu_register_write (PPU2C02 * const ppu, uint16_t const address, uint8_t co
 		case OAM_DATA:    /* $2004 */
 			if (ppu->scanline > 239 && ppu->scanline != 241)
 				ppu->OAMdata[ppu->OAMaddress] = data;
-			ppu->VRam.reg++;
+			ppu->OAMaddress++;
 			break;
 		case PPU_SCROLL:  /* $2005 */
 			if (ppu->latch == 0)
@@ -135,7 +140,7 @@ void ppu_register_write (PPU2C02 * const ppu, uint16_t const address, uint8_t co
 			}
 			break;
 		case PPU_DATA:   /* $2007 */
-			ppu_write (ppu, ppu->VRam.reg, data);
+			ppu_write (ppu, ppu->VRam.reg & 0x3fff, data);
 			ppu->VRam.reg += (ppu->control.VRAM_ADD_INCREMENT) ? 32 : 1;
 			ppu->VRam.reg = ppu->VRam.reg & 0x3fff;
 			break;
@@ -144,6 +149,26 @@ void ppu_register_write (PPU2C02 * const ppu, uint16_t const address, uint8_t co
 	}
 }
 
+void ppu_set_mirroring (PPU2C02 * const ppu, uint8_t const mirroring)
+{
+	/* Physical 1KB table used by each of the four nametable slots */
+	static const uint8_t layouts[5][4] =
+	{
+		[MIRROR_HORIZONTAL]  = { 0, 0, 1, 1 },
+		[MIRROR_VERTICAL]    = { 0, 1, 0, 1 },
+		[MIRROR_SINGLE_LOW]  = { 0, 0, 0, 0 },
+		[MIRROR_SINGLE_HIGH] = { 1, 1, 1, 1 },
+		[MIRROR_FOUR_SCREEN] = { 0, 1, 2, 3 }
+	};
+	assert (mirroring <= MIRROR_FOUR_SCREEN);
+
+	ppu->mirroring = mirroring;
+	for (int i = 0; i < 4; i++)
+	{
+		ppu->nameTablePage[i] = &ppu->nameTables[layouts[mirroring][i] * 0x400];
+	}
+}
+
 uint8_t ppu_read (PPU2C02 * const ppu, uint16_t address)
 {
 	/* Address should be mapped to lowest 16KB */
@@ -154,24 +179,12 @@ uint8_t ppu_read (PPU2C02 * const ppu, uint16_t address)
 	{
 		case 0 ... 0x1fff:
 			/* Read from CHR pattern table */
-			return ppu->mapper->read (ppu->mapper, address, 1);
+			return mapper_CHR_read (ppu->mapper, address);
 	
 		case 0x2000 ... 0x2fff:
 
-			address &= 0xfff;
 			/* Read from nametable data (mirrored every 4KB) */
-			if (ppu->mirroring == MIRROR_HORIZONTAL)
-			{
-				if (address >= 0xc00)
-					address -= 0x800;
-				if (address >= 0x800 || address >= 0x400)
-					address -= 0x400;
-			}
-			if (ppu->mirroring == MIRROR_VERTICAL)
-			{
-				address &= 0x7ff;
-			}
-			return ppu->nameTables[address];
+			return ppu->nameTablePage[(address >> 10) & 3][address & 0x3ff];
 
 		case 0x3000 ... 0x3eff:
 			return ppu_read (ppu, address - 0x1000);
@@ -198,25 +211,21 @@ void ppu_write (PPU2C02 * const ppu, uint16_t address, uint8_t const data)
 
 	if (address >= 0 && address <= 0x1fff)
 	{
-		/* Write to CHR pattern table */
-		ppu->mapper->write (ppu->mapper, address, data, 1);
+		/* Write to CHR pattern table, the tile needs decoding again in every
+		   window that maps the same bank (MMC1 can point both tables at one) */
+		const uint8_t * const bank = ppu->mapper->CHRwindow[(address >> 10) & 7];
+		mapper_CHR_write (ppu->mapper, address, data);
+
+		for (uint8_t w = 0; w < 8; w++)
+		{
+			if (ppu->mapper->CHRwindow[w] == bank)
+				ppu->tileValid[(w << 6) | ((address & 0x3ff) >> 4)] = 0;
+		}
 	}
 	else if (address >= 0x2000 && address <= 0x3eff)
 	{
-		address &= 0xfff;
 		/* Write to nametable data (mirrored every 4KB) */
-		if (ppu->mirroring == MIRROR_HORIZONTAL)
-		{
-			if (address >= 0xc00)
-				address -= 0x800;
-			if (address >= 0x800 || address >= 0x400)
-				address -= 0x400;
-		}
-		if (ppu->mirroring == MIRROR_VERTICAL)
-		{
-			address &= 0x7ff;
-		}
-		ppu->nameTables[address] = data;
+		ppu->nameTablePage[(address >> 10) & 3][address & 0x3ff] = data;
 	}
 	else if (address >= 0x3f00 && address <= 0x3fff)
 	{
@@ -235,169 +244,216 @@ void ppu_oam_dma_write (PPU2C02 * const ppu, uint8_t const data)
     ppu->OAMdata[ppu->OAMaddress++] = (uint8_t)data;
 }
 
-void ppu_pixel (PPU2C02 * const ppu, uint16_t x, uint16_t y, uint16_t color)
+/* Decoded tile cache */
+
+static void ppu_decode_tile (PPU2C02 * const ppu, uint16_t const tile)
 {
-	if (x > 256 || y > 240) return;
-	uint16_t p = (y << 8) + x;
+	const uint16_t offset = tile << 4;
+
+	for (uint8_t row = 0; row < 8; row++)
+	{
+		const uint8_t lsb = ppu_read (ppu, offset + row);
+		const uint8_t msb = ppu_read (ppu, offset + row + 8);
 
-	ppu->frameBuffer[p * 3]   = (uint8_t)(color >> 8) << 5;
-	ppu->frameBuffer[p * 3+1] = (uint8_t)(color >> 4) << 5;
-	ppu->frameBuffer[p * 3+2] = (uint8_t)(color << 5);
+		/* Combine bitplanes, leftmost pixel is the top bit */
+		for (uint8_t col = 0; col < 8; col++)
+		{
+			const uint8_t index = ((lsb >> (7 - col)) & 1) | (((msb >> (7 - col)) & 1) << 1);
+			ppu->tileCache[0][tile][row][col]     = index;
+			ppu->tileCache[1][tile][row][7 - col] = index;
+		}
+	}
+	ppu->tileValid[tile] = 1;
 }
 
-#define PPU_PIXEL
+/* Returns the 8 palette indexes for the tile row at a pattern table address */
 
-#ifdef PPU_PIXEL
-void ppu_background (PPU2C02 * const ppu, uint16_t const x, uint16_t const y)
+static inline const uint8_t * ppu_tile_row (PPU2C02 * const ppu, uint16_t const address, uint8_t const flip)
 {
-	if (!ppu->mask.RENDER_BG) return;
+	const uint16_t tile = (address >> 4) & 0x1ff;
 
-	uint16_t tileX = x / 8;
-	uint16_t tileY = y / 8;
-	uint16_t row = x % 8;
-	uint16_t col = y % 8;
+	if (!ppu->tileValid[tile])
+		ppu_decode_tile (ppu, tile);
 
-	int16_t pX = (tileX * 8 + col - (ppu->tmpVRam.coarseX * 8) - ppu->fineX);
-	int16_t pY = ((tileY * 8 + row - (ppu->tmpVRam.coarseY * 8) - ppu->tmpVRam.fineY));
-	uint8_t pTable = (ppu->control.BACKGROUND_PATTERN_ADDR);
-
-	/* Get offset value in memory based on tile position */
-	uint16_t baseTable = (ppu->control.flags & 0x3) * 0x400 + 0x2000;
-	
-	if (pX < 0)   pX += 256;
-	if (pX > 255) pX -= 256; 
-	if (pY < 0)   pY += 240;
-	if (pY > 239) pY -= 240;
-	uint8_t tile = ppu_read(ppu, ((tileY << 5) + tileX) + baseTable);
-
-	/* Get attribute table info */
-	uint16_t attrTableIndex = ((tileY >> 2) << 3) + (tileX >> 2);
-	uint8_t  attrByte = ppu_read(ppu, 0x23c0 + attrTableIndex);
-	uint8_t  palette  = attrByte >> (((tileY & 3) >> 1) << 2 | ((tileX & 3) >> 1) << 1) & 3;
-
-	/* Combine bitplanes and color the pixel */
-	uint16_t offset   = (pTable << 12) + (uint16_t)(tile << 4);
-	uint8_t  tile_lsb = ppu_read(ppu, offset + row + 8) >> (7 - col);
-	uint8_t  tile_msb = ppu_read(ppu, offset + row)     >> (7 - col);
-	uint8_t  index    = (tile_msb & 1) + ((tile_lsb & 1) << 1);
-
-	uint16_t palColor = palette2C03[ppu_read(ppu, 0x3f00 + (palette << 2) + index) & 0x3f];
-
-	ppu_pixel (ppu, pX, pY, palColor);
-	//ppu_pixel (ppu, xPos + col, yPos + row, palColor);
+	return ppu->tileCache[flip][tile][address & 7];
 }
-#else
-void ppu_background (PPU2C02 * const ppu, uint16_t const x, uint16_t const y)
-{
-	uint16_t pTable = (ppu->control.BACKGROUND_PATTERN_ADDR) ? 1 : 0;
 
-	/* Get offset value in memory based on tile position */
-	uint8_t baseTable = ppu->control.NAMETABLE_2 | ppu->control.NAMETABLE_1;
+/* Drop every decoded tile after a CHR bank switch */
 
-	for (int i = 0; i < 0x3c0; i++)
+static inline void ppu_check_CHR (PPU2C02 * const ppu)
+{
+	if (ppu->mapper->CHRdirty)
 	{
-		uint16_t yPos = (baseTable > 0) ? 240 : 0;
+		memset (&ppu->tileValid, 0, sizeof(ppu->tileValid));
+		ppu->mapper->CHRdirty = 0;
+	}
+}
 
-		/* Read nametable data */
-		uint8_t tile = ppu_read(ppu, i + (0x2000 + baseTable * 0x400));
-		uint8_t tileX = i % 32;
-		uint8_t tileY = i / 32;
+/* Sprite flags in the line buffer, the low 5 bits hold the palette index */
+#define SPRITE_BEHIND_BG   0x40
+#define SPRITE_ZERO        0x80
 
-		uint16_t offset = (pTable << 12) + (uint16_t)(tile << 4);
+/* Secondary OAM evaluation. Picks the first 8 sprites on the line in OAM order,
+   flagging overflow when there are more. Returns the number of sprites found */
 
-		/* Get attribute table info */
-		uint16_t attrTableIndex = ((tileY / 4) * 8) + tileX / 4;
-		uint8_t  attrByte = ppu_read(ppu, 0x23c0 + attrTableIndex);
-		uint8_t  palette  = attrByte >> ((tileY % 4 / 2) << 2 | (tileX % 4 / 2) << 1) & 3;
+static uint8_t ppu_sprite_evaluate (PPU2C02 * const ppu, uint16_t const y, uint8_t * const secondary)
+{
+	const uint8_t height = (ppu->control.SPRITE_SIZE) ? 16 : 8;
+	uint8_t found = 0;
 
-		for (int row = 0; row < 8; row++)
-		{
-			uint8_t tile_lsb = ppu_read(ppu, offset + row + 8);
-			uint8_t tile_msb = ppu_read(ppu, offset + row);
+	/* Sprites show one line below their Y coordinate */
+	for (uint8_t i = 0; i < 64; i++)
+	{
+		const int16_t row = (int16_t)y - 1 - ppu->OAMdata[i << 2];
+		if (row < 0 || row >= height) continue;
 
-			for (int col = 0; col < 8; col++)
-			{
-				/* Combine bitplanes and color the pixel */
-				uint8_t index = (tile_msb & 1) + ((tile_lsb & 1) << 1);
-				tile_lsb >>= 1;
-				tile_msb >>= 1;
-
-				/* Index 0 is transparent, skip pixel drawing */
-				ppu_pixel (ppu, tileX * 8 + (7 - col), yPos, 0);
-				if (index == 0) continue;
-
-				uint16_t palColor = palette2C03[ppu_read(ppu, 0x3f00 + (palette << 2) + index) & 0x3f];
-				ppu_pixel (
-					ppu, tileX * 8 + (7 - col), yPos + (tileY - ppu->VRam.coarseY) * 8 + row - ppu->VRam.fineY, 
-					palColor);
-			}
+		if (found == 8)
+		{
+			ppu->status.SPRITE_OVERFLOW = 1;
+			break;
 		}
+		secondary[found++] = i;
 	}
+
+	return found;
 }
-#endif
 
-void ppu_sprites (PPU2C02 * const ppu, uint16_t const x, uint16_t const y)
+/* Draw the sprites on the line into a line buffer where lower entries stay in front */
+
+static void ppu_sprite_line (PPU2C02 * const ppu, uint16_t const y, uint8_t * const spriteLine)
 {
-	if (!ppu->mask.RENDER_SPRITES) return;
+	const uint8_t height = (ppu->control.SPRITE_SIZE) ? 16 : 8;
+	uint8_t secondary[8];
+	const uint8_t found = ppu_sprite_evaluate (ppu, y, secondary);
 
-	uint8_t pTable  = (ppu->control.SPRITE_PATTERN_ADDR) ? 1 : 0;
+	ppu_check_CHR (ppu);
 
-	for (int i = 0; i < sizeof (ppu->OAMdata); i += 4) 
+	for (uint8_t i = 0; i < found; i++)
+	{
+		const uint8_t * const sprite = &ppu->OAMdata[secondary[i] << 2];
+		const uint8_t tile       = sprite[1];
+		const uint8_t attributes = sprite[2];
+		const uint8_t xPos       = sprite[3];
+
+		uint8_t row = y - 1 - sprite[0];
+		if (attributes & 0x80) 
+			row = height - 1 - row;
+
+		/* 8x16 sprites take the pattern table from bit 0 and use two tiles */
+		uint16_t address;
+		if (height == 16)
+			address = ((tile & 1) << 12) | ((tile & 0xfe) << 4) | ((row & 8) << 1) | (row & 7);
+		else
+			address = (ppu->control.SPRITE_PATTERN_ADDR << 12) | (tile << 4) | row;
+
+		const uint8_t * const pixels = ppu_tile_row (ppu, address, (attributes >> 6) & 1);
+		const uint8_t flags = 0x10 | ((attributes & 3) << 2) |
+			((attributes & 0x20) ? SPRITE_BEHIND_BG : 0) | ((secondary[i] == 0) ? SPRITE_ZERO : 0);
+
+		for (uint16_t col = 0; col < 8 && xPos + col < 256; col++)
+		{
+			if (pixels[col] && !spriteLine[xPos + col])
+				spriteLine[xPos + col] = flags | pixels[col];
+		}
+	}
+}
+
+/* Scanline renderer. The background for a whole line is drawn once the PPU is
+   past the visible dots, fetching name, attribute and pattern bytes once per tile */
+
+static void ppu_render_line (PPU2C02 * const ppu, uint16_t const y)
+{
+	/* Without video output only the sprite flags are needed. The line is only
+	   drawn when sprite 0 is on it and could hit the background */
+	if (ppu->suppressVideo)
 	{
-		uint8_t xPos       = ppu->OAMdata[i + 3];
-		uint8_t yPos       = ppu->OAMdata[i];
-		uint8_t tile       = ppu->OAMdata[i + 1];
-		uint8_t attributes = ppu->OAMdata[i + 2];
+		uint8_t secondary[8];
+		if (!ppu->mask.RENDER_BG && !ppu->mask.RENDER_SPRITES) return;
 
-		if (yPos > y + 8) continue;
+		const uint8_t found = ppu_sprite_evaluate (ppu, y, secondary);
+		if (!found || secondary[0] != 0 || !ppu->mask.RENDER_BG || !ppu->mask.RENDER_SPRITES)
+			return;
+	}
+
+	/* Palette indexes for the line, with room for 8 pixels of fine X scroll */
+	uint8_t line[256 + 8] = { 0 };
 
-		uint8_t Vflip = (attributes >> 7 & 1);
-		uint8_t Hflip = (attributes >> 6 & 1);
+	if (ppu->mask.RENDER_BG)
+	{
+		ppu_check_CHR (ppu);
 
-		uint8_t palette = (attributes & 3) | 4;
-		uint16_t offset = (pTable << 12) + (uint16_t)(tile << 4);
+		uint16_t v = ppu->VRam.reg;
+		const uint16_t pTable = ppu->control.BACKGROUND_PATTERN_ADDR << 12;
 
-		for (int row = 0; row < 8; row++)
+		for (uint16_t tileX = 0; tileX < 33; tileX++)
 		{
-			uint8_t tile_lsb = ppu_read(ppu, offset + row + 8);
-			uint8_t tile_msb = ppu_read(ppu, offset + row);
+			/* Attribute byte covers 4x4 tiles, pick the quadrant for this tile */
+			const uint8_t * const nameTable = ppu->nameTablePage[(v >> 10) & 3];
+			const uint8_t tile    = nameTable[v & 0x3ff];
+			const uint8_t attr    = nameTable[0x3c0 | ((v >> 4) & 0x38) | ((v >> 2) & 0x7)];
+			const uint8_t palette = ((attr >> (((v >> 4) & 4) | (v & 2))) & 3) << 2;
 
-			for (int col = 0; col < 8; col++)
+			const uint8_t * const row = ppu_tile_row (ppu, pTable + (tile << 4) + ppu->VRam.fineY, 0);
+
+			uint8_t * const out = &line[tileX << 3];
+			for (uint8_t col = 0; col < 8; col++)
 			{
-				/* Combine bitplanes and color the pixel */
-				uint8_t index = (tile_msb & 1) + ((tile_lsb & 1) << 1);
-				tile_lsb >>= 1;
-				tile_msb >>= 1;
+				out[col] = (row[col]) ? palette | row[col] : 0;
+			}
 
-				/* Index 0 is transparent, skip pixel drawing */
-				if (index == 0) continue;
+			/* Next tile, wrapping into the horizontally adjacent nametable */
+			if ((v & 0x1f) == 31)
+				v = (v & ~0x1f) ^ 0x400;
+			else
+				v++;
+		}
+	}
 
-				uint16_t palColor = palette2C03[ppu_read(ppu, 0x3f00 + (palette << 2) + index) & 0x3f];
-				uint8_t col1 = (Hflip) ? col : 7 - col;
-				uint8_t row1 = (Vflip) ? 7 - row + 1 : row + 1;
+	uint8_t sprites[256] = { 0 };
 
-				ppu_pixel (ppu, xPos + col1, yPos + row1, palColor);
-			}
+	if (ppu->mask.RENDER_BG || ppu->mask.RENDER_SPRITES)
+		ppu_sprite_line (ppu, y, sprites);
+
+	/* Combine both lines. Index 0 shows the backdrop color at $3f00 */
+	uint8_t * const pixels = &ppu->frameBuffer[y << 8];
+	const uint8_t gray = ppu->mask.GRAYSCALE ? 0x30 : 0x3f;
+	const uint8_t * const bg = &line[ppu->fineX];
+
+	for (uint16_t x = 0; x < 256; x++)
+	{
+		uint8_t index = (x < 8 && !ppu->mask.RENDER_BG_LEFT) ? 0 : bg[x];
+		const uint8_t sprite = (!ppu->mask.RENDER_SPRITES || (x < 8 && !ppu->mask.RENDER_SPRITES_LEFT)) ? 0 : sprites[x];
+
+		if (sprite)
+		{
+			/* Sprite 0 hits on opaque background, never on the last column */
+			if ((sprite & SPRITE_ZERO) && index && x < 255)
+				ppu->status.SPRITE_ZERO_HIT = 1;
+
+			if (!index || !(sprite & SPRITE_BEHIND_BG))
+				index = sprite & 0x1f;
 		}
+		pixels[x] = ppu->paletteTable[index] & gray;
 	}
+	ppu->emphasis[y] = ppu->mask.flags >> 5;
 }
 
-inline void ppu_nametable_fetch (PPU2C02 * const ppu)
+static inline void ppu_nametable_fetch (PPU2C02 * const ppu)
 {
 	ppu->nextTile.index = ppu_read (ppu, 0x2000 | (ppu->VRam.reg & 0xfff));
 }
 
-inline void ppu_attribute_fetch (PPU2C02 * const ppu)
+static inline void ppu_attribute_fetch (PPU2C02 * const ppu)
 {
 	/* To be implemented */	
 }
 
-inline void ppu_load_BG_shifters (PPU2C02 * const ppu)
+static inline void ppu_load_BG_shifters (PPU2C02 * const ppu)
 {
 	/* To be implemented */
 }
 
-inline void ppu_copy_X_scroll (PPU2C02 * const ppu)
+static inline void ppu_copy_X_scroll (PPU2C02 * const ppu)
 {
 	if (!ppu->mask.RENDER_BG && !ppu->mask.RENDER_SPRITES) return;
 
@@ -406,7 +462,7 @@ inline void ppu_copy_X_scroll (PPU2C02 * const ppu)
 	ppu->VRam.coarseX    = ppu->tmpVRam.coarseX;
 }
 
-inline void ppu_copy_Y_scroll (PPU2C02 * const ppu)
+static inline void ppu_copy_Y_scroll (PPU2C02 * const ppu)
 {
 	if (!ppu->mask.RENDER_BG && !ppu->mask.RENDER_SPRITES) return;
 
@@ -416,9 +472,93 @@ inline void ppu_copy_Y_scroll (PPU2C02 * const ppu)
 	ppu->VRam.coarseY    = ppu->tmpVRam.coarseY;
 }
 
+static inline void ppu_increment_Y (PPU2C02 * const ppu)
+{
+	if (!ppu->mask.RENDER_BG && !ppu->mask.RENDER_SPRITES) return;
+
+	/* Move down one pixel row, wrapping into the vertically adjacent nametable */
+	if (ppu->VRam.fineY < 7)
+	{
+		ppu->VRam.fineY++;
+		return;
+	}
+	ppu->VRam.fineY = 0;
+
+	if (ppu->VRam.coarseY == 29)
+	{
+		ppu->VRam.coarseY = 0;
+		ppu->VRam.nametableY ^= 1;
+	}
+	else 
+		ppu->VRam.coarseY++;
+}
+
 const uint32_t PPU_CYCLES_PER_FRAME = 89342; /* 341 cycles per 262 scanlines */
 
-void ppu_clock (PPU2C02 * const ppu)
+/* Dot counter layout used by ppu_step */
+#define PPU_LINE_DOTS      343
+#define PPU_VBLANK_LINE    242
+#define PPU_LAST_LINE      261
+
+/* Dot count at which a step on a given line and cycle has run, in this frame
+   or the next one */
+
+static uint64_t ppu_clock_at (PPU2C02 * const ppu, int16_t const line, int16_t const dot)
+{
+	const int16_t cycle    = ppu->cycle;
+	const int16_t scanline = ppu->scanline;
+	uint64_t dots;
+
+	if (scanline < line || (scanline == line && cycle <= dot))
+	{
+		dots = (line - scanline) * PPU_LINE_DOTS + dot - cycle;
+	}
+	else
+	{
+		/* Finish this frame, then the first line starts one dot later on odd frames */
+		const uint8_t firstCycle = ((ppu->frame + 1) % 2) ? 2 : 1;
+
+		dots = (PPU_LAST_LINE - scanline) * PPU_LINE_DOTS - cycle + 1;
+		dots += line * PPU_LINE_DOTS + dot - firstCycle;
+	}
+
+	return ppu->clockCount + dots + 1;
+}
+
+uint64_t ppu_next_vblank (PPU2C02 * const ppu)
+{
+	/* Count the dots left until a step starts on line 242, cycle 1 */
+	return ppu_clock_at (ppu, PPU_VBLANK_LINE, 1);
+}
+
+void ppu_schedule (PPU2C02 * const ppu)
+{
+	/* A12 rises when sprite patterns are fetched from $1000 after the
+	   background ones, or at the background fetch for the next line when
+	   only the background uses $1000. 8x16 sprites count as the first case */
+	if (!ppu->mapper || !ppu->mapper->scanline)
+		ppu->hookCycle = -1;
+	else
+		ppu->hookCycle = (ppu->control.BACKGROUND_PATTERN_ADDR && !ppu->control.SPRITE_PATTERN_ADDR &&
+			!ppu->control.SPRITE_SIZE) ? 324 : 260;
+
+	ppu->eventClock = ppu_next_vblank (ppu);
+
+	/* Scanline clocks happen on the pre-render line and the visible lines */
+	if (ppu->hookCycle >= 0 && ppu->mapper->scanlineSync)
+	{
+		const int16_t line = (ppu->cycle <= ppu->hookCycle) ? ppu->scanline : ppu->scanline + 1;
+		const uint64_t hook = ppu_clock_at (ppu, (line <= 240) ? line : 0, ppu->hookCycle);
+
+		if (hook < ppu->eventClock)
+			ppu->eventClock = hook;
+	}
+}
+
+/* One dot. hooked is a constant at each call site, so the mapper hook test
+   is compiled out of the loop run by boards without a scanline counter */
+
+static inline void ppu_step (PPU2C02 * const ppu, uint8_t const hooked)
 {
 	/*
 	  Line 
@@ -450,6 +590,8 @@ void ppu_clock (PPU2C02 * const ppu)
 	{				
 		if (scanline == 0 && cycle == 1) {
 			ppu->status.VERTICAL_BLANK = 0;
+			ppu->status.SPRITE_ZERO_HIT = 0;
+			ppu->status.SPRITE_OVERFLOW = 0;
 		}
 
 		if (cycle == 257) {
@@ -464,28 +606,23 @@ void ppu_clock (PPU2C02 * const ppu)
 
 	if (scanline == 242 && cycle == 1)
 	{
-		/* Debug nametable memory */
-		copy_nametable (ppu, 0);
-		copy_nametable (ppu, 1);
-		
 		ppu->status.VERTICAL_BLANK = 1;
 		if (ppu->control.ENABLE_NMI) 
 			ppu->nmi = 1;
+	}
 
-#ifndef PPU_PIXEL
-		ppu_background (ppu, cycle, scanline);
-#endif
-		//ppu_sprites (ppu);
+	/* Clock the mapper's scanline counter while rendering */
+	if (hooked && cycle == ppu->hookCycle && render && (ppu->mask.RENDER_BG || ppu->mask.RENDER_SPRITES))
+	{
+		ppu->mapper->scanline (ppu->mapper);
 	}
 
-#ifdef PPU_PIXEL
-	if (cycle < 256 && scanline < 240) 
+	/* Draw each visible line at the end of its visible dots */
+	if (cycle == 256 && scanline >= 1 && scanline <= 240)
 	{
-		ppu_background (ppu, cycle, scanline);
-		if (cycle == 255)
-			ppu_sprites (ppu, cycle, scanline);
+		ppu_render_line (ppu, scanline - 1);
+		ppu_increment_Y (ppu);
 	}
-#endif
 	ppu->cycle++;
 
 	if (cycle > 341)
@@ -504,14 +641,45 @@ void ppu_clock (PPU2C02 * const ppu)
 	}
 }
 
-void copy_nametable (PPU2C02 * const ppu, uint8_t const i)
+void ppu_clock (PPU2C02 * const ppu)
 {
-	/* Loop through nametable values (bg tiles) */
+	ppu_step (ppu, 1);
+	if (ppu->clockCount >= ppu->eventClock)
+		ppu_schedule (ppu);
+}
+
+/* Run the PPU for a number of dots, used to catch up with the CPU */
+
+void ppu_exec (PPU2C02 * const ppu, uint32_t const tickcount)
+{
+	/* NROM, CNROM, UxROM and MMC1 have no hook (see ppu_schedule) and take
+	   the specialized loop, MMC3 and future IRQ boards the generic one */
+	if (ppu->hookCycle < 0)
+	{
+		for (uint32_t i = 0; i < tickcount; i++)
+			ppu_step (ppu, 0);
+	}
+	else
+	{
+		for (uint32_t i = 0; i < tickcount; i++)
+			ppu_step (ppu, 1);
+	}
+
+	ppu_schedule (ppu);
+}
+
+static void copy_nametable (PPU2C02 * const ppu, PPUDebug * const view, uint8_t const i)
+{
+	/* Loop through nametable values (bg tiles) of physical table i, not the
+	   mirrored $2000 slot, so both tables show whatever the mirroring */
 	for (uint16_t ntTile = 0; ntTile < 960; ntTile++)
 	{
+		uint8_t val = ppu->nameTables[i * 0x400 + ntTile];
+		if (view->valid && view->names[i][ntTile] == val) continue;
+
+		view->names[i][ntTile] = val;
 		uint16_t xPos = (ntTile % 32) * 8;
 		uint16_t yPos = (ntTile / 32) * 8;
-		uint8_t val = ppu->nameTables[(i * 0x400) + ntTile];// ppu_read(ppu, 0x2000 + (i * 0x400) + ntTile);
 
 		for (uint16_t row = 0; row < 8; row++)
 		{
@@ -522,45 +690,73 @@ void copy_nametable (PPU2C02 * const ppu, uint8_t const i)
 				uint16_t pY = yPos + row;
 
 				/* Add to nametable, with a shade based on pixel value */
-				ppu->nTableDebug[i][(pY * 256 + pX) * 3]     =
-				ppu->nTableDebug[i][(pY * 256 + pX) * 3 + 1] =
-				ppu->nTableDebug[i][(pY * 256 + pX) * 3 + 2] = val;
+				view->nTable[i][(pY * 256 + pX) * 3]     =
+				view->nTable[i][(pY * 256 + pX) * 3 + 1] =
+				view->nTable[i][(pY * 256 + pX) * 3 + 2] = val;
 			}
 		}
 	}
 }
 
-void copy_pattern_table (PPU2C02 * const ppu, uint8_t const i) 
+static void copy_pattern_table (PPU2C02 * const ppu, PPUDebug * const view, uint8_t const i) 
 {
+	ppu_check_CHR (ppu);
+
 	for (uint16_t tile = 0; tile < 256; tile++)
 	{
 		/* Get offset value in memory based on tile position */
 		uint16_t offset = (i << 12) + ((tile / 16) << 8) + ((tile % 16) << 4);
 
+		/* Skip tiles whose CHR bytes are the same as last time */
+		uint8_t changed = !view->valid;
+		for (uint16_t byte = 0; byte < 16; byte++)
+		{
+			const uint8_t data = ppu_read (ppu, offset + byte);
+			changed |= (view->CHR[offset + byte] != data);
+			view->CHR[offset + byte] = data;
+		}
+		if (!changed) continue;
+
 		/* Loop through each row of a tile */
 		for (uint16_t row = 0; row < 8; row++)
 		{
-			uint8_t tile_lsb = ppu_read (ppu, offset + row);
-			uint8_t tile_msb = ppu_read (ppu, offset + row + 8);
+			const uint8_t * const pixels = ppu_tile_row (ppu, offset + row, 0);
 
-			/* Loop through a single row of the bit planes and combine values */
 			for (uint16_t col = 0; col < 8; col++)
 			{
-				/* Get rightmost bit from each byte in memory */
-				uint8_t pixel = (tile_lsb & 1) + ((tile_msb & 1) << 1);
-
-				/* X axis needs to be flipped */
-				uint16_t pX = ((tile & 0xf) << 3) + (7 - col);
+				uint16_t pX = ((tile & 0xf) << 3) + col;
 				uint16_t pY = ((tile >> 4) << 3)  + row;
 
 				/* Add to pattern table, with a shade based on pixel value */
-				ppu->pTableDebug[i][(pY * 128 + pX) * 3]     =
-				ppu->pTableDebug[i][(pY * 128 + pX) * 3 + 1] =
-				ppu->pTableDebug[i][(pY * 128 + pX) * 3 + 2] = pixel * 0x55;
-
-				tile_lsb >>= 1;
-				tile_msb >>= 1;
+				view->pTable[i][(pY * 128 + pX) * 3]     =
+				view->pTable[i][(pY * 128 + pX) * 3 + 1] =
+				view->pTable[i][(pY * 128 + pX) * 3 + 2] = pixels[col] * 0x55;
 			}
 		}
 	}
+}
+
+PPUDebug * ppu_debug_view (PPU2C02 * const ppu)
+{
+	if (!ppu->debugView)
+	{
+		ppu->debugView = calloc (1, sizeof(PPUDebug));
+		if (!ppu->debugView) return NULL;
+	}
+	PPUDebug * const view = ppu->debugView;
+
+	for (uint8_t i = 0; i < 2; i++)
+	{
+		copy_nametable (ppu, view, i);
+		copy_pattern_table (ppu, view, i);
+	}
+	view->valid = 1;
+
+	return view;
+}
+
+void ppu_debug_free (PPU2C02 * const ppu)
+{
+	free (ppu->debugView);
+	ppu->debugView = NULL;
 }
\ No newline at end of file
@@ -7,18 +7,26 @@
 
 typedef struct PPU2C02_Struct 
 {
-    enum ppuRegisters 
-    {
-        PPU_CONTROL = 0,
-        PPU_MASK    = 1,
-        PPU_STATUS  = 2,
-        OAM_ADDRESS = 3,
-        OAM_DATA    = 4,
-        PPU_SCROLL  = 5,
-        PPU_ADDRESS = 6,
-        PPU_DATA    = 7
-    }
-    ppuRegisters;
+    /* Hot state, used every dot or on register access. Kept within the
+       first two cache lines, see the layout checks in bus.h */
+
+    /* Clock info and helpers */
+    int16_t  cycle, scanline;
+
+    union
+	{
+		struct /* xEEEDCBB BBBAAAAA */
+		{
+			uint16_t coarseX : 5;
+			uint16_t coarseY : 5;
+			uint16_t nametableX : 1;
+			uint16_t nametableY : 1;
+			uint16_t fineY : 3;
+			uint16_t unused : 1;
+		};
+		uint16_t reg;
+	}
+    VRam, tmpVRam;
 
     union
     {
@@ -67,34 +75,47 @@ typedef struct PPU2C02_Struct
     }
     status;
 
-    union
-	{
-		struct /* xEEEDCBB BBBAAAAA */
-		{
-			uint16_t coarseX : 5;
-			uint16_t coarseY : 5;
-			uint16_t nametableX : 1;
-			uint16_t nametableY : 1;
-			uint16_t fineY : 3;
-			uint16_t unused : 1;
-		};
-		uint16_t reg;
-	}
-    VRam, tmpVRam;
-
     /* Internal state */
     uint8_t  latch, dataBuffer;
     uint8_t  fineX;
     uint8_t  nmi;
-
-    /* PPU memory, with direct access to CHR data */
-    uint8_t  nameTables[2048];
-    uint8_t  VRamData[8192];
-    uint8_t  OAMdata[256];
-    uint8_t  paletteTable[32];
     uint8_t  OAMaddress;
+    uint8_t  mirroring;
+    uint8_t  debug;
+
+    /* Skip drawing frames, while still raising sprite 0 hit and overflow */
+    uint8_t  suppressVideo;
+
+    /* Dot of each rendered line that clocks the mapper's scanline counter, -1 for none */
+    int16_t  hookCycle;
+
+    uint64_t clockCount, clockGoal;
+
+    /* Next dot the CPU has to see on time: vertical blank, or a scanline
+       clock while the mapper can raise an IRQ */
+    uint64_t eventClock;
+    uint32_t frame;
     Mapper  *mapper;
 
+    /* Nametable slots at $2000, $2400, $2800 and $2c00, set by the mirroring
+       mode. Only four screen mode uses the upper 2KB of nametable memory */
+    uint8_t *nameTablePage[4];
+    uint8_t  paletteTable[32];
+
+    /* Cold state */
+    enum ppuRegisters 
+    {
+        PPU_CONTROL = 0,
+        PPU_MASK    = 1,
+        PPU_STATUS  = 2,
+        OAM_ADDRESS = 3,
+        OAM_DATA    = 4,
+        PPU_SCROLL  = 5,
+        PPU_ADDRESS = 6,
+        PPU_DATA    = 7
+    }
+    ppuRegisters;
+
     /* Temp storage */
     struct NextTile_struct
     {
@@ -107,20 +128,40 @@ typedef struct PPU2C02_Struct
 	uint16_t bg_shifter_pattern_lo;
 	uint16_t bg_shifter_pattern_hi;
 
-    /* Clock info and helpers */
-    int16_t  cycle, scanline;
-    uint64_t clockCount, clockGoal;
-    uint32_t frame;
-    uint8_t  mirroring;
-    uint8_t  debug;
+    /* Debug images, only allocated while the debug view is on */
+    struct PPUDebug_struct * debugView;
+
+    /* Bulk memory. Nametables, OAM and pattern tables */
+    uint8_t  nameTables[4096];
+    uint8_t  OAMdata[256];
+
+    /* Decoded pattern tables, 8 palette indexes per tile row. The second set
+       is flipped horizontally. Tiles are decoded from CHR on first use */
+    uint8_t  tileValid[512];
+    uint8_t  tileCache[2][512][8][8];
 
-    /* Byte arrays of graphics output */
-    uint8_t nTableDebug[2][256 * 240 * 3];
-    uint8_t pTableDebug[2][128 * 128 * 3];
-    uint8_t frameBuffer[256 * 256 * 3];
+    /* Byte array of graphics output. The frame holds 6-bit palette
+       indexes, with the color emphasis bits of each line kept apart.
+       See palette_convert for turning them into RGB */
+    uint8_t frameBuffer[256 * 240];
+    uint8_t emphasis[240];
 }
 PPU2C02;
 
+/* Nametable and pattern table images for the debug view. The last nametable
+   and CHR bytes drawn are kept so only changed tiles are drawn again */
+
+typedef struct PPUDebug_struct
+{
+    uint8_t nTable[2][256 * 240 * 3];
+    uint8_t pTable[2][128 * 128 * 3];
+
+    uint8_t names[2][960];
+    uint8_t CHR[8192];
+    uint8_t valid;
+}
+PPUDebug;
+
 /* Forward declare ROM */
 
 typedef struct NESrom_struct NESrom;
@@ -131,6 +172,16 @@ void    ppu_reset     (PPU2C02 * const ppu, NESrom * const rom);
 void    ppu_clock     (PPU2C02 * const ppu);
 void    ppu_exec      (PPU2C02 * const ppu, uint32_t const tickcount);
 
+/* Dot count at which the next vertical blank (and NMI) is raised */
+uint64_t ppu_next_vblank (PPU2C02 * const ppu);
+
+/* Work out the scanline clock dot and eventClock again. Called
+   after the PPU runs and whenever the mapper or PPU control changes */
+void    ppu_schedule  (PPU2C02 * const ppu);
+
+/* Point the nametable slots at memory for a mirroring mode from NESrom */
+void    ppu_set_mirroring  (PPU2C02 * const ppu, uint8_t const mirroring);
+
 uint8_t ppu_read           (PPU2C02 * const ppu, uint16_t address);
 void    ppu_write          (PPU2C02 * const ppu, uint16_t address, uint8_t const data);
 uint8_t ppu_register_read  (PPU2C02 * const ppu, uint16_t const address);
@@ -140,10 +191,18 @@ void    ppu_oam_dma_write  (PPU2C02 * const ppu, uint8_t const data);
 /* Debug and draw functions */
 
 void ppu_set_pixel         (PPU2C02 * const ppu, uint16_t const x, uint16_t const y);
-void copy_nametable        (PPU2C02 * const ppu, uint8_t const i);
-void copy_pattern_table    (PPU2C02 * const ppu, uint8_t const i);
+
+/* Bring the debug images up to date and return them, allocating on first use */
+PPUDebug * ppu_debug_view  (PPU2C02 * const ppu);
+void       ppu_debug_free  (PPU2C02 * const ppu);
 
 inline uint8_t ppu_show_debug   (PPU2C02 * const ppu) { return ppu->debug; }
-inline void    ppu_toggle_debug (PPU2C02 * const ppu) { ppu->debug = ~ppu->debug; }
+
+/* Turning the debug view off releases its images */
+inline void    ppu_toggle_debug (PPU2C02 * const ppu)
+{
+    ppu->debug = ~ppu->debug;
+    if (!ppu->debug) ppu_debug_free (ppu);
+}
 
 #endif
\ No newline at end of file
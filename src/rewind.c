@@ -0,0 +1,239 @@
+#include <stdlib.h>
+#include <string.h>
+#include "bus.h"
+#include "state.h"
+#include "rewind.h"
+
+/* Each record is framed by its length on both sides, so it can be dropped
+   from the tail and read back from the head */
+
+#define RECORD_FRAME_SIZE 8
+
+/* NTSC frames in one minute */
+#define FRAMES_PER_MINUTE 3606.0
+
+/* Records are sequences of (zero run, literal count, literal bytes). Counts
+   are stored 7 bits at a time, low bits first */
+
+static inline uint8_t * put_varint (uint8_t * p, size_t value)
+{
+    while (value >= 0x80) {
+        *p++ = (value & 0x7f) | 0x80;
+        value >>= 7;
+    }
+    *p++ = value;
+    return p;
+}
+
+static inline size_t get_varint (const uint8_t ** p)
+{
+    size_t value = 0;
+    uint8_t shift = 0;
+    uint8_t byte;
+    do {
+        byte = *(*p)++;
+        value |= (size_t)(byte & 0x7f) << shift;
+        shift += 7;
+    }
+    while (byte & 0x80);
+
+    return value;
+}
+
+/* Encode the XOR of two states. A literal run ends at three or more matching
+   bytes, shorter gaps cost less to store inline */
+
+static size_t rewind_encode (const uint8_t * const a, const uint8_t * const b, size_t const size, uint8_t * const out)
+{
+    uint8_t * p = out;
+    size_t i = 0;
+
+    while (i < size)
+    {
+        size_t start = i;
+        while (i < size && a[i] == b[i]) i++;
+        p = put_varint (p, i - start);
+
+        start = i;
+        while (i < size)
+        {
+            if (a[i] == b[i] && (i + 2 >= size || (a[i + 1] == b[i + 1] && a[i + 2] == b[i + 2])))
+                break;
+            i++;
+        }
+        p = put_varint (p, i - start);
+
+        for (; start < i; start++)
+            *p++ = a[start] ^ b[start];
+    }
+
+    return p - out;
+}
+
+static void rewind_apply (const uint8_t * p, size_t const size, uint8_t * const target)
+{
+    const uint8_t * const end = p + size;
+    size_t i = 0;
+
+    while (p < end)
+    {
+        i += get_varint (&p);
+        size_t literals = get_varint (&p);
+        while (literals--)
+            target[i++] ^= *p++;
+    }
+}
+
+/* Ring access, positions wrap around at capacity */
+
+static void ring_write (Rewind * const rw, size_t pos, const uint8_t * src, size_t size)
+{
+    const size_t first = (size < rw->capacity - pos) ? size : rw->capacity - pos;
+    memcpy (rw->ring + pos, src, first);
+    memcpy (rw->ring, src + first, size - first);
+}
+
+static void ring_read (Rewind * const rw, size_t pos, uint8_t * dest, size_t size)
+{
+    const size_t first = (size < rw->capacity - pos) ? size : rw->capacity - pos;
+    memcpy (dest, rw->ring + pos, first);
+    memcpy (dest + first, rw->ring, size - first);
+}
+
+static inline size_t ring_pos (Rewind * const rw, size_t const pos)
+{
+    return (pos >= rw->capacity) ? pos - rw->capacity : pos;
+}
+
+static uint32_t ring_read32 (Rewind * const rw, size_t const pos)
+{
+    uint32_t value;
+    ring_read (rw, pos, (uint8_t*)&value, 4);
+    return value;
+}
+
+static void rewind_drop_oldest (Rewind * const rw)
+{
+    const size_t size = ring_read32 (rw, rw->tail) + RECORD_FRAME_SIZE;
+
+    rw->tail = ring_pos (rw, rw->tail + size);
+    rw->used -= size;
+    rw->count--;
+}
+
+uint8_t rewind_init (Rewind * const rw, size_t const capacity, uint16_t const interval)
+{
+    *rw = (Rewind){0};
+    rw->ring = malloc (capacity);
+    if (!rw->ring)
+        return 0;
+
+    rw->capacity = capacity;
+    rw->interval = interval ? interval : 1;
+    return 1;
+}
+
+void rewind_free (Rewind * const rw)
+{
+    free (rw->ring);
+    free (rw->latest);
+    free (rw->scratch);
+    *rw = (Rewind){0};
+}
+
+void rewind_clear (Rewind * const rw)
+{
+    rw->head = rw->tail = rw->used = 0;
+    rw->count = 0;
+    rw->frames = 0;
+}
+
+/* Buffers for the newest state, and the state being taken followed by its
+   encoding. Every token after the first skips at least three matching bytes,
+   so the encoding is never more than a few bytes larger than the state */
+
+static uint8_t rewind_alloc (Rewind * const rw, size_t const stateSize)
+{
+    free (rw->latest);
+    free (rw->scratch);
+    rw->latest  = malloc (stateSize);
+    rw->scratch = malloc (stateSize * 2 + 16);
+    rw->stateSize = (rw->latest && rw->scratch) ? stateSize : 0;
+    rewind_clear (rw);
+
+    return rw->stateSize != 0;
+}
+
+void rewind_push (Rewind * const rw, Bus * const bus)
+{
+    if (!rw->ring || ++rw->frames < rw->interval)
+        return;
+
+    rw->frames = 0;
+
+    /* A different cartridge or memory configuration starts a new history */
+    const size_t stateSize = bus_state_size (bus);
+    if (stateSize != rw->stateSize && !rewind_alloc (rw, stateSize))
+        return;
+
+    uint8_t * const current = rw->scratch;
+    uint8_t * const record  = rw->scratch + stateSize;
+    bus_save_state (bus, current);
+
+    /* The oldest record is never applied, so the first one is left empty */
+    const uint32_t size = rw->count ? rewind_encode (rw->latest, current, stateSize, record) : 0;
+    const size_t   recordSize = size + RECORD_FRAME_SIZE;
+
+    if (recordSize > rw->capacity)
+    {
+        rewind_clear (rw);
+        return;
+    }
+    while (rw->used + recordSize > rw->capacity)
+        rewind_drop_oldest (rw);
+
+    ring_write (rw, rw->head, (uint8_t*)&size, 4);
+    ring_write (rw, ring_pos (rw, rw->head + 4), record, size);
+    ring_write (rw, ring_pos (rw, rw->head + 4 + size), (uint8_t*)&size, 4);
+
+    rw->head = ring_pos (rw, rw->head + recordSize);
+    rw->used += recordSize;
+    rw->count++;
+
+    memcpy (rw->latest, current, stateSize);
+}
+
+uint8_t rewind_pop (Rewind * const rw, Bus * const bus)
+{
+    if (!rw->count)
+        return 0;
+
+    if (!bus_load_state (bus, rw->latest, rw->stateSize))
+    {
+        rewind_clear (rw);
+        return 0;
+    }
+
+    /* Step the newest state back to the one before it */
+    const size_t   last = (rw->head >= 4) ? rw->head - 4 : rw->head + rw->capacity - 4;
+    const uint32_t size = ring_read32 (rw, last);
+    const size_t   recordSize = size + RECORD_FRAME_SIZE;
+
+    rw->head = (rw->head >= recordSize) ? rw->head - recordSize : rw->head + rw->capacity - recordSize;
+    rw->used -= recordSize;
+    rw->count--;
+
+    ring_read (rw, ring_pos (rw, rw->head + 4), rw->scratch, size);
+    rewind_apply (rw->scratch, size, rw->latest);
+    rw->frames = 0;
+
+    return 1;
+}
+
+double rewind_bytes_per_minute (Rewind * const rw)
+{
+    if (!rw->count)
+        return 0;
+
+    return rw->used * FRAMES_PER_MINUTE / ((double)rw->count * rw->interval);
+}
@@ -0,0 +1,49 @@
+#ifndef REWIND_H
+#define REWIND_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Rewind history. A save state is taken every few frames and stored in a
+   fixed size ring as the XOR against the state taken after it, with runs of
+   zero bytes collapsed. Only the newest state is kept whole; stepping back
+   loads it and XORs the newest record into it to get the one before. When
+   the ring is full the oldest records are dropped */
+
+#define REWIND_DEFAULT_CAPACITY (8 << 20)
+#define REWIND_DEFAULT_INTERVAL 2
+
+typedef struct Bus_struct Bus;
+
+typedef struct Rewind_struct
+{
+    /* Encoded records, newest at head */
+    uint8_t * ring;
+    size_t capacity, head, tail, used;
+    uint32_t count;
+
+    /* Newest state, and a buffer for encoding and reading back records */
+    uint8_t * latest;
+    uint8_t * scratch;
+    size_t stateSize;
+
+    /* Frames between snapshots */
+    uint16_t interval, frames;
+}
+Rewind;
+
+uint8_t rewind_init  (Rewind * const, size_t const capacity, uint16_t const interval);
+void    rewind_free  (Rewind * const);
+void    rewind_clear (Rewind * const);
+
+/* Call once per emulated frame, takes a snapshot every interval frames */
+void    rewind_push  (Rewind * const, Bus * const bus);
+
+/* Load the newest snapshot and drop it from the history. Returns 0 if
+   there is nothing left to rewind to */
+uint8_t rewind_pop   (Rewind * const, Bus * const bus);
+
+/* Average history size in bytes for one minute of play */
+double  rewind_bytes_per_minute (Rewind * const);
+
+#endif
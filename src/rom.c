@@ -1,79 +1,158 @@
-#include <libgen.h>
+#define _POSIX_C_SOURCE 200809L
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "bus.h"
 
 void rom_eject (NESrom * const rom)
 {
-    vc_free (&rom->PRGdata);
-    vc_free (&rom->CHRdata);
-    vc_free (&rom->mapper.localCHR);
+    /* Only CHR RAM is allocated, PRG and CHR ROM are views into the image */
+    if (rom->mapper.usesCHR)
+        vc_free (&rom->CHRdata);
+
+    if (rom->imageMapped)
+        munmap (rom->image, rom->imageSize);
+    else
+        free (rom->image);
+
+    rom->image = NULL;
+    rom->imageSize = 0;
+    rom->imageMapped = 0;
+    memset (&rom->PRGdata, 0, sizeof(rom->PRGdata));
+    memset (&rom->CHRdata, 0, sizeof(rom->CHRdata));
+
+    free (rom->mapper.props);
+    rom->mapper.props = NULL;
+    rom->mapper.propsSize = 0;
 
     memset(&rom->filename[0], 0, sizeof(rom->filename));
     rom->valid = 0;
     rom->mapper.usesCHR = 0;
 }
 
-uint8_t rom_load (Bus * const bus, const char* pathname)
+/* The image must be iNES, have PRG ROM to boot from and hold every bank its
+   header declares */
+
+static uint8_t rom_check_image (const uint8_t * const image, size_t const size)
+{
+    uint32_t headerString = 0;
+    if (size < 16)
+        return 0;
+
+    memcpy (&headerString, image, sizeof(headerString));
+
+    return headerString == 0x1a53454e && /* Chars "NES" + 0x1a */
+        image[4] > 0 && size >= 16 + image[4] * 16384 + image[5] * 8192;
+}
+
+/* Take ownership of a checked image and point PRG and CHR into it */
+
+static void rom_attach (Bus * const bus, uint8_t * const image, size_t const size, uint8_t const mapped, const char * name)
 {
     NESrom * rom = &bus->rom;
-    rom->valid = 0;
+    rom_eject (&bus->rom);
 
-    uint8_t *filebuf = (uint8_t*)read_file_short (pathname);
-    uint32_t headerString = 0;
-    memcpy (&headerString, filebuf, sizeof(headerString));
+    rom->valid = 1;
+    rom->image = image;
+    rom->imageSize = size;
+    rom->imageMapped = mapped;
 
-    if (headerString == 0x1a53454e) /* Chars "NES" + 0x1a */
+    /* Copy header, PRG ROM starts after it at a 16 byte offset */
+    memcpy (rom->header, image, sizeof(rom->header));
+    strncpy (rom->filename, name ? name : "", sizeof(rom->filename) - 1);
+    rom->mapperID = (rom->header[6] >> 4) | (rom->header[7] & 0xf0);
+
+    /* After getting the rom info, the correct mapper can be obtained */
+    rom->mirroring = (rom->header[6] & 8) ? MIRROR_FOUR_SCREEN : rom->header[6] & 1;
+    rom->mapper    = mapper_apply (rom->header, rom->mapperID);
+    rom->mapper.mirroring = rom->mirroring;
+
+    if (rom->verbose)
     {
-        const char * file = basename(pathname);
-        rom_eject (&bus->rom);
-
-        rom->valid = 1;
-
-        /* Copy header and PRG rom from 16 byte offset */
-        memcpy (rom->header,   filebuf, sizeof(rom->header));
-        memcpy (rom->filename, file,    128);
-        rom->mapperID = (rom->header[6] >> 4) | (rom->header[7] & 0xf0);
-
-        /* After getting the rom info, the correct mapper can be obtained */
-        rom->mirroring = rom->header[6] & 1;
-        rom->mapper    = mapper_apply (rom->header, rom->mapperID);
-
-        /* Add the PRG and CHR data, pre-allocate 8KB if CHR RAM */
-        vc_init (&rom->PRGdata, 1);
-        vc_init (&rom->CHRdata, 1);
-        vc_init (&rom->mapper.localCHR, 1);
-
-        printf("Mirroring: %s\n", rom->mirroring == 0 ? "Horizontal" : "Vertical");
-        /* Add trainer data if needed */
-
-        vc_push_array (&rom->PRGdata, filebuf, rom->mapper.PRGbanks * 16384, sizeof(rom->header));
-        vc_push_array (&rom->CHRdata, filebuf, rom->mapper.CHRbanks * 8192,  sizeof(rom->header) + rom->PRGdata.total);
-
-        /* Uses local CHR */
-        if (vc_size(&rom->CHRdata) == 0)
-        {
-            for (int i = 0; i < 0x4000; i++) vc_push (&rom->mapper.localCHR, 0);
-            rom->mapper.usesCHR = 1;
-        }
-
-        if (rom->mapper.CHRbanks == 0) 
-        {
-            printf("No CHR found\n");
-            for (int i = 0; i < 0x4000; i++) vc_push (&rom->CHRdata, 0);
-        }
-
-        rom->mapper.PRG = &rom->PRGdata;
-        rom->mapper.CHR = &rom->CHRdata;
-        rom->mapper.lastBankStart = vc_size(&rom->PRGdata) - 0x4000;
-
-        bus_reset (bus);
-        printf("Rom loaded! (%s)\n", rom->filename);
-        printf("capacity: %d %d \n", vc_size(&rom->PRGdata), vc_size(&rom->CHRdata));
-
-        /* Test disassembly output */
-        /* cpu_disassemble (bus, bus->cpu.r.pc, bus->cpu.r.pc + 0x80); */
-        return 1;
+        fprintf(stderr, "Mapper type %d, read %d PRG bank(s) and %d CHR bank(s). (%d KB and %d KB)\n", rom->mapperID,
+            rom->mapper.PRGbanks, rom->mapper.CHRbanks,
+            rom->mapper.PRGbanks * 16, rom->mapper.CHRbanks * 8);
+        fprintf(stderr, "Mirroring: %s\n", rom->mirroring == MIRROR_FOUR_SCREEN ? "Four screen" :
+            rom->mirroring == MIRROR_HORIZONTAL ? "Horizontal" : "Vertical");
     }
+    /* Add trainer data if needed */
+
+    rom->PRGdata.data  = image + sizeof(rom->header);
+    rom->PRGdata.total = rom->PRGdata.capacity = rom->mapper.PRGbanks * 16384;
+    rom->CHRdata.data  = rom->PRGdata.data + rom->PRGdata.total;
+    rom->CHRdata.total = rom->CHRdata.capacity = rom->mapper.CHRbanks * 8192;
+
+    /* No CHR ROM, the mapper gets 8KB of CHR RAM in its place */
+    if (vc_size(&rom->CHRdata) == 0)
+    {
+        if (rom->verbose) fprintf(stderr, "No CHR found\n");
+        vc_init (&rom->CHRdata, 0x2000);
+        memset (rom->CHRdata.data, 0, 0x2000);
+        rom->CHRdata.total = 0x2000;
+        rom->mapper.usesCHR = 1;
+    }
+
+    rom->mapper.PRG = &rom->PRGdata;
+    rom->mapper.CHR = &rom->CHRdata;
+    rom->mapper.lastBankStart = vc_size(&rom->PRGdata) - 0x4000;
+
+    bus_reset (bus);
+    if (rom->verbose) fprintf(stderr, "Rom loaded! (%s)\n", rom->filename);
+
+    /* Test disassembly output */
+    /* cpu_disassemble (bus, bus->cpu.r.pc, bus->cpu.r.pc + 0x80); */
+}
+
+uint8_t rom_load (Bus * const bus, const char* pathname)
+{
+    struct stat info;
+    const int fd = open (pathname, O_RDONLY);
+    if (fd < 0)
+    {
+        fprintf(stderr, "Cannot open file '%s'\n", pathname);
+        return 0;
+    }
+
+    /* Map the file read-only, the mapping stays open while the cartridge is in */
+    uint8_t * image = MAP_FAILED;
+    if (fstat (fd, &info) == 0 && info.st_size > 0)
+        image = mmap (NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close (fd);
+
+    if (image == MAP_FAILED)
+    {
+        fprintf(stderr, "Cannot map file '%s'\n", pathname);
+        return 0;
+    }
+
+    size_t const size = info.st_size;
+    if (bus->rom.verbose) fprintf(stderr, "Bytes mapped: %lu ('%s')\n", (unsigned long)size, pathname);
+
+    if (!rom_check_image (image, size))
+    {
+        munmap (image, size);
+        return 0;
+    }
+
+    /* Show the file name without its directories */
+    const char * const slash = strrchr (pathname, '/');
+    rom_attach (bus, image, size, 1, slash ? slash + 1 : pathname);
+    return 1;
+}
+
+uint8_t rom_load_memory (Bus * const bus, const uint8_t * const filebuf, size_t const size, const char * name)
+{
+    if (!rom_check_image (filebuf, size))
+        return 0;
+
+    /* The caller keeps its buffer, so the image is copied once */
+    uint8_t * const image = malloc (size);
+    if (!image)
+        return 0;
+
+    memcpy (image, filebuf, size);
+    rom_attach (bus, image, size, 0, name);
 
-    free (filebuf);
-    return 0;
+    return 1;
 }
\ No newline at end of file
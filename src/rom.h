@@ -4,21 +4,20 @@
 
 typedef struct NESrom_struct
 {
-    enum mirroringType 
-    {
-        MIRROR_HORIZONTAL = 0,
-        MIRROR_VERTICAL   = 1
-    }
-    mirroringType;
-
     char    filename[128];
     uint8_t header[16];
     uint8_t trainer[512];
-    uint8_t mirroring;
+    uint8_t mirroring; /* Header mirroring, see mirroringType */
     uint8_t mapperID;
     uint8_t valid;
+    uint8_t verbose; /* Print load details to stderr, errors always print */
+
+    /* The iNES image, mapped read-only from a file or copied from memory */
+    uint8_t *image;
+    size_t   imageSize;
+    uint8_t  imageMapped;
 
-    /* Dynamic arrays for PRG and CHR data */
+    /* PRG and CHR ROM are views into the image, CHR RAM is allocated */
     struct VArray PRGdata;
     struct VArray CHRdata;
 
@@ -31,4 +30,8 @@ NESrom;
 typedef struct Bus_struct Bus;
 
 uint8_t rom_load  (Bus    * const bus, const char* pathname);
+
+/* Load an iNES image already in memory. The data is copied, name is only
+   used for display and may be NULL. rom_load maps the file instead */
+uint8_t rom_load_memory (Bus * const bus, const uint8_t * const data, size_t const size, const char * name);
 void    rom_eject (NESrom * const rom);
\ No newline at end of file
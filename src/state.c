@@ -0,0 +1,417 @@
+#include <string.h>
+#include "bus.h"
+#include "state.h"
+
+extern inline void bus_map_reset (Bus * const bus);
+
+#define STATE_HEADER_SIZE 8
+#define CHUNK_HEADER_SIZE 8
+#define CHR_RAM_SIZE      0x2000
+
+/* Payload sizes of the fixed chunks in this version. Loading accepts larger
+   chunks, newer fields are only ever appended */
+
+#define ROM_CHUNK_SIZE  4
+#define BUS_CHUNK_SIZE  12
+#define CPU_CHUNK_SIZE  31
+#define PPU_CHUNK_SIZE  29
+#define MAPR_CHUNK_SIZE 1
+
+/* Little endian field writers, each returns the position after the field */
+
+static inline uint8_t * put8 (uint8_t * p, uint8_t const value)
+{
+    *p = value;
+    return p + 1;
+}
+
+static inline uint8_t * put16 (uint8_t * p, uint16_t const value)
+{
+    p[0] = value;
+    p[1] = value >> 8;
+    return p + 2;
+}
+
+static inline uint8_t * put32 (uint8_t * p, uint32_t const value)
+{
+    p = put16 (p, value);
+    return put16 (p, value >> 16);
+}
+
+static inline uint8_t * put64 (uint8_t * p, uint64_t const value)
+{
+    p = put32 (p, value);
+    return put32 (p, value >> 32);
+}
+
+static inline uint8_t * put_bytes (uint8_t * p, const void * const src, size_t const size)
+{
+    memcpy (p, src, size);
+    return p + size;
+}
+
+/* Field readers, advance the read position */
+
+static inline uint8_t get8 (const uint8_t ** p)
+{
+    return *(*p)++;
+}
+
+static inline uint16_t get16 (const uint8_t ** p)
+{
+    const uint16_t value = (*p)[0] | ((*p)[1] << 8);
+    *p += 2;
+    return value;
+}
+
+static inline uint32_t get32 (const uint8_t ** p)
+{
+    const uint32_t low = get16 (p);
+    return low | ((uint32_t)get16 (p) << 16);
+}
+
+static inline uint64_t get64 (const uint8_t ** p)
+{
+    const uint64_t low = get32 (p);
+    return low | ((uint64_t)get32 (p) << 32);
+}
+
+/* Chunks are written as tag, size and payload. The size is filled in when
+   the chunk is closed */
+
+static inline uint8_t * chunk_begin (uint8_t * p, const char tag[4])
+{
+    memcpy (p, tag, 4);
+    return p + CHUNK_HEADER_SIZE;
+}
+
+static inline uint8_t * chunk_end (uint8_t * const start, uint8_t * const p)
+{
+    put32 (start - 4, p - start);
+    return p;
+}
+
+/* Nametable memory in use, the upper 2KB only exists in four screen mode */
+
+static inline uint16_t state_nametable_size (Bus * const bus)
+{
+    return (bus->ppu.mirroring == MIRROR_FOUR_SCREEN) ? 4096 : 2048;
+}
+
+static inline uint32_t state_CHR_RAM_size (Bus * const bus)
+{
+    return bus->rom.mapper.usesCHR ? CHR_RAM_SIZE : 0;
+}
+
+size_t bus_state_size (Bus * const bus)
+{
+    size_t size = STATE_HEADER_SIZE;
+
+    size += CHUNK_HEADER_SIZE + ROM_CHUNK_SIZE;
+    size += CHUNK_HEADER_SIZE + BUS_CHUNK_SIZE;
+    size += CHUNK_HEADER_SIZE + CPU_CHUNK_SIZE;
+    size += CHUNK_HEADER_SIZE + sizeof(bus->ram);
+    size += CHUNK_HEADER_SIZE + PPU_CHUNK_SIZE;
+    size += CHUNK_HEADER_SIZE + sizeof(bus->ppu.paletteTable);
+    size += CHUNK_HEADER_SIZE + sizeof(bus->ppu.OAMdata);
+    size += CHUNK_HEADER_SIZE + state_nametable_size (bus);
+    size += CHUNK_HEADER_SIZE + MAPR_CHUNK_SIZE;
+
+    if (state_CHR_RAM_size (bus))
+        size += CHUNK_HEADER_SIZE + state_CHR_RAM_size (bus);
+    if (bus->rom.mapper.propsSize)
+        size += CHUNK_HEADER_SIZE + bus->rom.mapper.propsSize;
+
+    return size + CHUNK_HEADER_SIZE;
+}
+
+size_t bus_save_state (Bus * const bus, uint8_t * const buf)
+{
+    CPU6502 * const cpu = &bus->cpu;
+    PPU2C02 * const ppu = &bus->ppu;
+    Mapper  * const mapper = &bus->rom.mapper;
+    uint8_t * p = buf;
+    uint8_t * chunk;
+
+    p = put_bytes (p, "NSST", 4);
+    p = put16 (p, STATE_VERSION);
+    p = put16 (p, 0);
+
+    /* Cartridge the state belongs to */
+    chunk = p = chunk_begin (p, "ROM ");
+    p = put8  (p, bus->rom.mapperID);
+    p = put8  (p, mapper->PRGbanks);
+    p = put8  (p, mapper->CHRbanks);
+    p = put8  (p, bus->rom.mirroring);
+    p = chunk_end (chunk, p);
+
+    chunk = p = chunk_begin (p, "BUS ");
+    p = put64 (p, bus->clockCount);
+    p = put_bytes (p, bus->controller, 2);
+    p = put_bytes (p, bus->controllerState, 2);
+    p = chunk_end (chunk, p);
+
+    chunk = p = chunk_begin (p, "CPU ");
+    p = put16 (p, cpu->r.pc);
+    p = put8  (p, cpu->r.sp);
+    p = put8  (p, cpu->r.status);
+    p = put8  (p, cpu->r.a);
+    p = put8  (p, cpu->r.x);
+    p = put8  (p, cpu->r.y);
+    p = put64 (p, cpu->instructions);
+    p = put64 (p, cpu->clockCount);
+    p = put64 (p, cpu->clockGoal);
+    p = chunk_end (chunk, p);
+
+    chunk = p = chunk_begin (p, "RAM ");
+    p = put_bytes (p, bus->ram, sizeof(bus->ram));
+    p = chunk_end (chunk, p);
+
+    chunk = p = chunk_begin (p, "PPU ");
+    p = put16 (p, ppu->cycle);
+    p = put16 (p, ppu->scanline);
+    p = put16 (p, ppu->VRam.reg);
+    p = put16 (p, ppu->tmpVRam.reg);
+    p = put8  (p, ppu->control.flags);
+    p = put8  (p, ppu->mask.flags);
+    p = put8  (p, ppu->status.flags);
+    p = put8  (p, ppu->latch);
+    p = put8  (p, ppu->dataBuffer);
+    p = put8  (p, ppu->fineX);
+    p = put8  (p, ppu->nmi);
+    p = put8  (p, ppu->OAMaddress);
+    p = put8  (p, ppu->mirroring);
+    p = put32 (p, ppu->frame);
+    p = put64 (p, ppu->clockCount);
+    p = chunk_end (chunk, p);
+
+    chunk = p = chunk_begin (p, "PAL ");
+    p = put_bytes (p, ppu->paletteTable, sizeof(ppu->paletteTable));
+    p = chunk_end (chunk, p);
+
+    chunk = p = chunk_begin (p, "OAM ");
+    p = put_bytes (p, ppu->OAMdata, sizeof(ppu->OAMdata));
+    p = chunk_end (chunk, p);
+
+    chunk = p = chunk_begin (p, "NTAB");
+    p = put_bytes (p, ppu->nameTables, state_nametable_size (bus));
+    p = chunk_end (chunk, p);
+
+    /* Mapper registers, plus any mapper specific properties and CHR RAM */
+    chunk = p = chunk_begin (p, "MAPR");
+    p = put8  (p, mapper->bankSelect);
+    p = chunk_end (chunk, p);
+
+    if (state_CHR_RAM_size (bus))
+    {
+        chunk = p = chunk_begin (p, "CHRR");
+        p = put_bytes (p, mapper->CHR->data, state_CHR_RAM_size (bus));
+        p = chunk_end (chunk, p);
+    }
+    if (mapper->propsSize)
+    {
+        chunk = p = chunk_begin (p, "PROP");
+        p = put_bytes (p, mapper->props, mapper->propsSize);
+        p = chunk_end (chunk, p);
+    }
+
+    chunk = p = chunk_begin (p, "END ");
+    p = chunk_end (chunk, p);
+
+    return p - buf;
+}
+
+/* Compare a chunk's tag as one word */
+
+static inline uint8_t chunk_is (const uint8_t * const p, const char tag[4])
+{
+    uint32_t a, b;
+    memcpy (&a, p, 4);
+    memcpy (&b, tag, 4);
+    return a == b;
+}
+
+/* Find a chunk's payload, which must be at least minSize bytes. The chunk
+   list has been checked to lie within the buffer already */
+
+static const uint8_t * state_find (
+    const uint8_t * const buf, size_t const size, const char tag[4], uint32_t const minSize)
+{
+    const uint8_t * p = buf + STATE_HEADER_SIZE;
+
+    while (p + CHUNK_HEADER_SIZE <= buf + size)
+    {
+        const uint8_t * sizeField = p + 4;
+        const uint32_t chunkSize = get32 (&sizeField);
+
+        if (chunk_is (p, tag))
+            return (chunkSize >= minSize) ? p + CHUNK_HEADER_SIZE : NULL;
+        if (chunk_is (p, "END "))
+            break;
+
+        p += CHUNK_HEADER_SIZE + chunkSize;
+    }
+    return NULL;
+}
+
+/* Check the header and that every chunk lies within the buffer */
+
+static uint8_t state_check (const uint8_t * const buf, size_t const size)
+{
+    if (size < STATE_HEADER_SIZE || !chunk_is (buf, "NSST"))
+        return 0;
+
+    const uint8_t * p = buf + 4;
+    if (get16 (&p) > STATE_VERSION)
+        return 0;
+
+    p = buf + STATE_HEADER_SIZE;
+    while (p < buf + size)
+    {
+        if ((size_t)(buf + size - p) < CHUNK_HEADER_SIZE)
+            return 0;
+
+        const uint8_t * sizeField = p + 4;
+        const uint32_t chunkSize = get32 (&sizeField);
+
+        if (chunkSize > (size_t)(buf + size - p) - CHUNK_HEADER_SIZE)
+            return 0;
+
+        if (chunk_is (p, "END "))
+            return 1;
+
+        p += CHUNK_HEADER_SIZE + chunkSize;
+    }
+    return 0;
+}
+
+uint8_t bus_load_state (Bus * const bus, const uint8_t * const buf, size_t const size)
+{
+    CPU6502 * const cpu = &bus->cpu;
+    PPU2C02 * const ppu = &bus->ppu;
+    Mapper  * const mapper = &bus->rom.mapper;
+
+    if (!state_check (buf, size))
+        return 0;
+
+    /* The state must come from the same kind of cartridge */
+    const uint8_t * rom = state_find (buf, size, "ROM ", ROM_CHUNK_SIZE);
+    if (!rom ||
+        rom[0] != bus->rom.mapperID || rom[1] != mapper->PRGbanks ||
+        rom[2] != mapper->CHRbanks  || rom[3] != bus->rom.mirroring)
+        return 0;
+
+    const uint8_t * busChunk = state_find (buf, size, "BUS ", BUS_CHUNK_SIZE);
+    const uint8_t * cpuChunk = state_find (buf, size, "CPU ", CPU_CHUNK_SIZE);
+    const uint8_t * ram      = state_find (buf, size, "RAM ", sizeof(bus->ram));
+    const uint8_t * ppuChunk = state_find (buf, size, "PPU ", PPU_CHUNK_SIZE);
+    const uint8_t * palette  = state_find (buf, size, "PAL ", sizeof(ppu->paletteTable));
+    const uint8_t * OAM      = state_find (buf, size, "OAM ", sizeof(ppu->OAMdata));
+    const uint8_t * names    = state_find (buf, size, "NTAB", state_nametable_size (bus));
+    const uint8_t * mapr     = state_find (buf, size, "MAPR", MAPR_CHUNK_SIZE);
+    const uint8_t * CHRram   = state_find (buf, size, "CHRR", state_CHR_RAM_size (bus));
+    const uint8_t * props    = state_find (buf, size, "PROP", mapper->propsSize);
+
+    if (!busChunk || !cpuChunk || !ram || !ppuChunk || !palette || !OAM || !names || !mapr)
+        return 0;
+    if ((state_CHR_RAM_size (bus) && !CHRram) || (mapper->propsSize && !props))
+        return 0;
+
+    /* Mirroring mode follows the four VRAM address words and nine PPU bytes */
+    if (ppuChunk[16] > MIRROR_FOUR_SCREEN)
+        return 0;
+
+    /* Everything is present, restore the console */
+    const uint8_t * p = busChunk;
+    bus->clockCount = get64 (&p);
+    memcpy (bus->controller, p, 2);
+    memcpy (bus->controllerState, p + 2, 2);
+
+    p = cpuChunk;
+    cpu->r.pc     = get16 (&p);
+    cpu->r.sp     = get8  (&p);
+    cpu->r.status = get8  (&p);
+    cpu->r.a      = get8  (&p);
+    cpu->r.x      = get8  (&p);
+    cpu->r.y      = get8  (&p);
+    cpu->instructions = get64 (&p);
+    cpu->clockCount   = get64 (&p);
+    cpu->clockGoal    = get64 (&p);
+
+    memcpy (bus->ram, ram, sizeof(bus->ram));
+
+    p = ppuChunk;
+    ppu->cycle          = get16 (&p);
+    ppu->scanline       = get16 (&p);
+    ppu->VRam.reg       = get16 (&p);
+    ppu->tmpVRam.reg    = get16 (&p);
+    ppu->control.flags  = get8  (&p);
+    ppu->mask.flags     = get8  (&p);
+    ppu->status.flags   = get8  (&p);
+    ppu->latch          = get8  (&p);
+    ppu->dataBuffer     = get8  (&p);
+    ppu->fineX          = get8  (&p);
+    ppu->nmi            = get8  (&p);
+    ppu->OAMaddress     = get8  (&p);
+    ppu->mirroring      = get8  (&p);
+    ppu->frame          = get32 (&p);
+    ppu->clockCount     = get64 (&p);
+
+    memcpy (ppu->paletteTable, palette, sizeof(ppu->paletteTable));
+    memcpy (ppu->OAMdata, OAM, sizeof(ppu->OAMdata));
+    memcpy (ppu->nameTables, names, state_nametable_size (bus));
+
+    /* Decoded tiles stay valid unless CHR windows (repointed below) or CHR RAM change */
+    mapper->bankSelect = mapr[0];
+    if (props) memcpy (mapper->props, props, mapper->propsSize);
+    if (CHRram)
+    {
+        memcpy (mapper->CHR->data, CHRram, state_CHR_RAM_size (bus));
+        memset (ppu->tileValid, 0, sizeof(ppu->tileValid));
+    }
+
+    /* Rebuild what is derived from the restored registers: page tables,
+       nametable slots and the next vblank */
+    bus_map_reset (bus);
+    ppu_set_mirroring (ppu, ppu->mirroring);
+    ppu_schedule (ppu);
+
+    return 1;
+}
+
+/* Power on. Whatever is left from earlier runs is cleared and RAM gets a
+   fill pattern from the seed, so a run depends only on the seed and input */
+
+void bus_power_on (Bus * const bus, uint32_t const seed)
+{
+    PPU2C02 * const ppu = &bus->ppu;
+    Mapper  * const mapper = &bus->rom.mapper;
+    uint32_t x = seed;
+
+    for (size_t i = 0; i < sizeof(bus->ram); i++)
+    {
+        /* xorshift32, seed 0 leaves RAM cleared */
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        bus->ram[i] = x >> 24;
+    }
+
+    memset (bus->controller, 0, sizeof(bus->controller));
+    memset (bus->controllerState, 0, sizeof(bus->controllerState));
+    bus->irq = 0;
+    bus->cpu.r = (struct Registers){ 0 };
+    bus->cpu.instructions = 0;
+
+    memset (ppu->paletteTable, 0, sizeof(ppu->paletteTable));
+    memset (ppu->OAMdata, 0, sizeof(ppu->OAMdata));
+    ppu->OAMaddress = ppu->nmi = 0;
+
+    mapper->bankSelect = 0;
+    mapper->CHRdirty = 1;
+    if (mapper->props) memset (mapper->props, 0, mapper->propsSize);
+    if (mapper->props && mapper->init) mapper->init (mapper);
+    if (mapper->usesCHR) memset (mapper->CHR->data, 0, mapper->CHR->total);
+
+    bus_reset (bus);
+}
@@ -0,0 +1,32 @@
+#ifndef STATE_H
+#define STATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Save states. A state is an 8 byte header ("NSST", version, reserved) followed
+   by chunks of a fourCC tag, a 32 bit little endian payload size and the
+   payload. Loading skips chunks it doesn't know, so newer chunks can be added
+   without breaking older states. ROM data, the frame buffer and debug images
+   are not saved; the frame is complete again after the next rendered frame */
+
+#define STATE_VERSION 1
+
+typedef struct Bus_struct Bus;
+
+/* Bytes needed to save the current console */
+size_t  bus_state_size (Bus * const bus);
+
+/* Write the state to buf, which must hold bus_state_size bytes. Returns the
+   number of bytes written */
+size_t  bus_save_state (Bus * const bus, uint8_t * const buf);
+
+/* Restore a state saved from the same ROM. Returns 0 and leaves the console
+   untouched if the state is malformed or made for a different cartridge */
+uint8_t bus_load_state (Bus * const bus, const uint8_t * const buf, size_t const size);
+
+/* Put the loaded cartridge's console in its power on state. RAM is filled
+   from seed, and cleared for seed 0 */
+void    bus_power_on   (Bus * const bus, uint32_t const seed);
+
+#endif
@@ -26,11 +26,14 @@ inline char* pathname (const char* filename)
     return dir;
 }
 
-inline char* read_file_short (const char* filename)
+/* Read a whole file, null terminated. The size without the terminator is
+   written to fileSize if it isn't NULL */
+
+inline char* read_file (const char* filename, size_t* fileSize)
 {	
 	FILE *f = fopen(filename, "rb");
 	if (f == NULL) {
-        printf("Cannot open file '%s'\n", filename);
+        fprintf(stderr, "Cannot open file '%s'\n", filename);
         return NULL;
     }
 
@@ -38,20 +41,27 @@ inline char* read_file_short (const char* filename)
 	long size = ftell(f);
 	fseek(f, 0, SEEK_SET);
 
-	printf("Bytes read: %lu (\033[96m'%s'\033[0m)\n", size, filename);
+	fprintf(stderr, "Bytes read: %lu ('%s')\n", size, filename);
 
 	char *buf = malloc(size + 1);
 	if (!fread(buf, 1, size, f)) 
 	{
 		fclose(f);
+		free(buf);
 		return NULL;
 	}
 	fclose(f);
 
 	/* End with null character */
 	buf[size] = 0;
+	if (fileSize) *fileSize = size;
 
 	return buf;
 }
 
+inline char* read_file_short (const char* filename)
+{
+	return read_file (filename, NULL);
+}
+
 #endif
\ No newline at end of file
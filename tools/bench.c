@@ -0,0 +1,299 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../src/bus.h"
+#include "../src/nesemu.h"
+#include "../src/movie.h"
+
+/* Benchmark runner. Runs fixed workloads from power on and times every frame,
+   writing a JSON report that can be diffed between commits. The core's cycle
+   and instruction counters are read directly, so this includes bus.h like the
+   GUI does.
+
+   ne-semu-bench [-frames N] [-warmup N] [-out report.json] [-nestest nestest.nes]
+                 [rom.nes | rom.nes,movie.nsmv] ...
+
+   ROMs run without input for the given frames, a ROM paired with a movie runs
+   the movie through to its end. nestest runs in automation mode from $c000,
+   where one pass of the test counts as a frame and the hash field holds its
+   result bytes at $02 and $03 (0 when every test passes). `make bench`
+   generates the synthetic workloads with tools/romgen.c and runs them with any
+   extras given.
+
+   Cycle, instruction and hash fields only change when emulation changes, the
+   timing fields depend on the machine */
+
+#define DEFAULT_FRAMES 1200
+#define DEFAULT_WARMUP 60
+
+/* nestest in automation mode ends with an RTS from here */
+#define NESTEST_START 0xc000
+#define NESTEST_END   0xc66e
+
+typedef struct Result_struct
+{
+    char   * name;
+    uint8_t  ok;
+    uint32_t frames;
+
+    /* Per frame timing, in milliseconds */
+    double   mean, p50, p99;
+    double   seconds;
+
+    uint64_t cpuCycles, ppuDots, instructions;
+    uint64_t hash;
+}
+Result;
+
+static double now (void)
+{
+    struct timespec t;
+    clock_gettime (CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static int compare_time (const void * a, const void * b)
+{
+    const double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+/* FNV-1a of the last frame, the same as ne-semu-cli -hashes */
+
+static uint64_t frame_hash (NESemu * const emu)
+{
+    const uint8_t * emphasis;
+    const uint8_t * const frame = nesemu_frame (emu, &emphasis);
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    for (uint32_t i = 0; i < NESEMU_WIDTH * NESEMU_HEIGHT; i++)
+        hash = (hash ^ frame[i]) * 0x100000001b3ULL;
+    for (uint32_t i = 0; i < NESEMU_HEIGHT; i++)
+        hash = (hash ^ emphasis[i]) * 0x100000001b3ULL;
+
+    return hash;
+}
+
+/* One pass of nestest from $c000 with the registers it expects */
+
+static void nestest_pass (Bus * const bus)
+{
+    bus->cpu.r.pc = NESTEST_START;
+    bus->cpu.r.sp = 0xfd;
+    bus->cpu.r.status = FLAG_CONSTANT | FLAG_INTERRUPT;
+
+    for (uint32_t steps = 0; bus->cpu.r.pc != NESTEST_END && steps < 100000; steps++)
+        bus_step (bus);
+
+    bus->cpu.clockGoal = bus->clockCount;
+    bus_sync (bus, bus->clockCount);
+}
+
+/* Workload kinds */
+
+enum Workload
+{
+    WORKLOAD_ROM,
+    WORKLOAD_MOVIE,
+    WORKLOAD_NESTEST
+};
+
+static void run_workload (Result * const result, enum Workload const kind, const char * const rom,
+    const char * const moviePath, uint32_t frames, uint32_t const warmup)
+{
+    NESemu * const emu = nesemu_create ();
+    Movie movie = { 0 };
+
+    if (!emu || !nesemu_load_file (emu, rom) ||
+        (kind == WORKLOAD_MOVIE && (!movie_load_file (&movie, moviePath) || !movie_play_start (&movie, emu))))
+    {
+        fprintf (stderr, "Cannot run workload '%s'\n", result->name);
+        nesemu_destroy (emu);
+        movie_free (&movie);
+        return;
+    }
+
+    /* Movies start from their own power on, the rest from a cleared one */
+    if (kind != WORKLOAD_MOVIE)
+        nesemu_power_on (emu, 0);
+    else
+        frames = movie.frames > warmup ? movie.frames - warmup : 0;
+
+    Bus * const bus = emu;
+    double * const times = malloc ((frames ? frames : 1) * sizeof(double));
+    uint64_t cpuStart = 0, ppuStart = 0, instStart = 0;
+
+    for (uint32_t frame = 0; frame < warmup + frames; frame++)
+    {
+        if (frame == warmup)
+        {
+            cpuStart  = bus->clockCount;
+            ppuStart  = bus->ppu.clockCount;
+            instStart = bus->cpu.instructions;
+        }
+        const double start = now ();
+
+        if (kind == WORKLOAD_NESTEST)
+            nestest_pass (bus);
+        else
+        {
+            if (kind == WORKLOAD_MOVIE) movie_play_frame (&movie, emu);
+            nesemu_run_frame (emu);
+        }
+
+        if (frame >= warmup)
+            times[frame - warmup] = now () - start;
+    }
+
+    result->ok           = 1;
+    result->frames       = frames;
+    result->cpuCycles    = bus->clockCount - cpuStart;
+    result->ppuDots      = bus->ppu.clockCount - ppuStart;
+    result->instructions = bus->cpu.instructions - instStart;
+    result->hash         = (kind == WORKLOAD_NESTEST) ? bus->ram[2] | (bus->ram[3] << 8) : frame_hash (emu);
+
+    result->seconds = 0;
+    for (uint32_t i = 0; i < frames; i++)
+        result->seconds += times[i];
+
+    if (frames)
+    {
+        qsort (times, frames, sizeof(double), compare_time);
+        result->mean = result->seconds * 1000 / frames;
+        result->p50  = times[(frames - 1) / 2] * 1000;
+        result->p99  = times[(frames - 1) * 99 / 100] * 1000;
+    }
+
+    free (times);
+    movie_free (&movie);
+    nesemu_destroy (emu);
+}
+
+static double per_second (uint64_t const count, double const seconds)
+{
+    return seconds > 0 ? count / seconds : 0;
+}
+
+static uint8_t write_report (const char * const path, Result * const results, uint32_t const count,
+    uint32_t const frames, uint32_t const warmup)
+{
+    FILE * f = fopen (path, "w");
+    if (!f) return 0;
+
+    fprintf (f, "{\n  \"frames\": %u,\n  \"warmup\": %u,\n  \"workloads\": [\n", frames, warmup);
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        Result * const r = &results[i];
+        fprintf (f, "    {\n");
+        fprintf (f, "      \"name\": \"%s\",\n", r->name);
+        fprintf (f, "      \"ok\": %s,\n", r->ok ? "true" : "false");
+        fprintf (f, "      \"frames\": %u,\n", r->frames);
+        fprintf (f, "      \"cpu_cycles\": %llu,\n", (unsigned long long)r->cpuCycles);
+        fprintf (f, "      \"ppu_dots\": %llu,\n", (unsigned long long)r->ppuDots);
+        fprintf (f, "      \"instructions\": %llu,\n", (unsigned long long)r->instructions);
+        fprintf (f, "      \"hash\": \"%016llx\",\n", (unsigned long long)r->hash);
+        fprintf (f, "      \"frame_ms\": { \"mean\": %.4f, \"p50\": %.4f, \"p99\": %.4f },\n", r->mean, r->p50, r->p99);
+        fprintf (f, "      \"cpu_cycles_per_sec\": %.0f,\n", per_second (r->cpuCycles, r->seconds));
+        fprintf (f, "      \"ppu_dots_per_sec\": %.0f,\n", per_second (r->ppuDots, r->seconds));
+        fprintf (f, "      \"instructions_per_sec\": %.0f\n", per_second (r->instructions, r->seconds));
+        fprintf (f, "    }%s\n", (i + 1 < count) ? "," : "");
+    }
+
+    fprintf (f, "  ]\n}\n");
+    return fclose (f) == 0;
+}
+
+/* Workload name from the file name, without directories or extension */
+
+static char * workload_name (const char * const path)
+{
+    const char * base = strrchr (path, '/');
+    base = base ? base + 1 : path;
+
+    char * const name = strdup (base);
+    char * const dot = strrchr (name, '.');
+    if (dot && dot != name) *dot = 0;
+
+    return name;
+}
+
+int main (int argc, char** argv)
+{
+    const char * outPath = "bench.json";
+    const char * nestestPath = NULL;
+    uint32_t frames = DEFAULT_FRAMES;
+    uint32_t warmup = DEFAULT_WARMUP;
+
+    Result * const results = calloc (argc, sizeof(Result));
+    uint32_t count = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if      (!strcmp (argv[i], "-frames")  && i + 1 < argc) frames = strtoul (argv[++i], NULL, 0);
+        else if (!strcmp (argv[i], "-warmup")  && i + 1 < argc) warmup = strtoul (argv[++i], NULL, 0);
+        else if (!strcmp (argv[i], "-out")     && i + 1 < argc) outPath = argv[++i];
+        else if (!strcmp (argv[i], "-nestest") && i + 1 < argc) nestestPath = argv[++i];
+        else if (argv[i][0] == '-')
+        {
+            fprintf (stderr, "Unknown option '%s'\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (nestestPath)
+    {
+        results[count].name = strdup ("nestest");
+        run_workload (&results[count++], WORKLOAD_NESTEST, nestestPath, NULL, frames, warmup);
+    }
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (argv[i][0] == '-') { i++; continue; }
+
+        /* rom.nes,movie.nsmv plays a movie */
+        char * const rom = strdup (argv[i]);
+        char * const moviePath = strchr (rom, ',');
+        if (moviePath) *moviePath = 0;
+
+        results[count].name = workload_name (moviePath ? moviePath + 1 : rom);
+        run_workload (&results[count++], moviePath ? WORKLOAD_MOVIE : WORKLOAD_ROM, rom,
+            moviePath ? moviePath + 1 : NULL, frames, warmup);
+        free (rom);
+    }
+
+    if (!count)
+    {
+        fprintf (stderr, "Usage: %s [-frames N] [-warmup N] [-out report.json] [-nestest nestest.nes] [rom.nes | rom.nes,movie.nsmv] ...\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    int status = EXIT_SUCCESS;
+    printf ("workload          frames  mean ms   p50 ms   p99 ms  cpu Mcyc/s  ppu Mdot/s  Minst/s\n");
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        Result * const r = &results[i];
+        if (!r->ok) status = EXIT_FAILURE;
+
+        printf ("%-16s %7u %8.3f %8.3f %8.3f %11.2f %11.2f %8.2f\n", r->name, r->frames, r->mean, r->p50, r->p99,
+            per_second (r->cpuCycles, r->seconds) / 1e6, per_second (r->ppuDots, r->seconds) / 1e6,
+            per_second (r->instructions, r->seconds) / 1e6);
+    }
+
+    if (!write_report (outPath, results, count, frames, warmup))
+    {
+        fprintf (stderr, "Cannot write '%s'\n", outPath);
+        status = EXIT_FAILURE;
+    }
+    else
+        printf ("Report written to %s\n", outPath);
+
+    for (uint32_t i = 0; i < count; i++)
+        free (results[i].name);
+    free (results);
+
+    return status;
+}
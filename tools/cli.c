@@ -0,0 +1,477 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "../src/nesemu.h"
+#include "../src/movie.h"
+
+/* Headless runner. Loads a ROM, runs a number of frames as fast as possible
+   and reports emulation speed, for regression runs and throughput checks.
+
+   ne-semu-cli rom.nes [-frames N] [-input file] [-ppm out.ppm] [-hashes]
+                       [-record movie] [-seed N]
+   ne-semu-cli -batch manifest [-frames N] [-threads N] [-scaling]
+
+   The input file is either a movie (see movie.h), played from power on until
+   it ends, or text with one line per frame holding the controller 1 buttons
+   as a hex byte, optionally followed by controller 2 (see NESEMU_BUTTON_*).
+   In text files blank lines and lines starting with # are skipped, and the
+   last buttons are held once the file runs out. -record saves the run as a
+   movie, starting from power on with RAM filled from the seed. Results go to
+   stdout as "hash <frame> <hash>" and "fps" lines, load errors go to stderr.
+
+   Batch mode runs every job in a manifest on a pool of threads, each thread
+   running one console at a time. A manifest line is
+
+   rom.nes [input|-] [frames|-] [hash]
+
+   with the hash as printed by -hashes for the last frame. Jobs with a hash
+   pass or fail against it. -scaling runs the batch again with 1, 2, 4 ...
+   threads up to the thread count and reports the speedup of each, so drops
+   in efficiency stand out */
+
+#define DEFAULT_FRAMES 600
+
+typedef struct Input_struct
+{
+    uint8_t (*buttons)[2];
+    uint32_t count;
+
+    Movie   movie;
+    uint8_t isMovie;
+}
+Input;
+
+static uint8_t input_load (Input * const input, const char * const path)
+{
+    if (movie_load_file (&input->movie, path))
+    {
+        input->isMovie = 1;
+        return 1;
+    }
+
+    FILE * f = fopen (path, "r");
+    if (!f) return 0;
+
+    uint32_t capacity = 0;
+    char line[256];
+
+    while (fgets (line, sizeof(line), f))
+    {
+        unsigned int p1 = 0, p2 = 0;
+        if (line[0] == '#' || sscanf (line, "%x %x", &p1, &p2) < 1)
+            continue;
+
+        if (input->count == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 1024;
+            input->buttons = realloc (input->buttons, capacity * sizeof(*input->buttons));
+        }
+        input->buttons[input->count][0] = p1;
+        input->buttons[input->count][1] = p2;
+        input->count++;
+    }
+
+    fclose (f);
+    return 1;
+}
+
+static void input_free (Input * const input)
+{
+    free (input->buttons);
+    movie_free (&input->movie);
+}
+
+/* Frames to run when none are asked for */
+
+static uint32_t input_frames (Input const * const input, uint32_t const frames)
+{
+    return input->isMovie ? input->movie.frames : frames;
+}
+
+/* FNV-1a over the palette indexes and emphasis bits of a frame */
+
+static uint64_t frame_hash (NESemu * const emu)
+{
+    const uint8_t * emphasis;
+    const uint8_t * const frame = nesemu_frame (emu, &emphasis);
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    for (uint32_t i = 0; i < NESEMU_WIDTH * NESEMU_HEIGHT; i++)
+        hash = (hash ^ frame[i]) * 0x100000001b3ULL;
+    for (uint32_t i = 0; i < NESEMU_HEIGHT; i++)
+        hash = (hash ^ emphasis[i]) * 0x100000001b3ULL;
+
+    return hash;
+}
+
+static uint8_t write_ppm (NESemu * const emu, const char * const path)
+{
+    static uint8_t pixels[NESEMU_WIDTH * NESEMU_HEIGHT * 3];
+    FILE * f = fopen (path, "wb");
+    if (!f) return 0;
+
+    nesemu_frame_pixels (emu, PIXEL_RGB24, pixels);
+    fprintf (f, "P6\n%d %d\n255\n", NESEMU_WIDTH, NESEMU_HEIGHT);
+    const size_t written = fwrite (pixels, 1, sizeof(pixels), f);
+    fclose (f);
+
+    return written == sizeof(pixels);
+}
+
+static double now (void)
+{
+    struct timespec t;
+    clock_gettime (CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/* Run frames with the buttons from an input file, stopping early when a movie
+   ends. Movies start from power on. Returns the time taken */
+
+static double run_frames (NESemu * const emu, Input * const input, uint32_t * const frames,
+    uint8_t const hashes, Movie * const record)
+{
+    if (input->isMovie && !movie_play_start (&input->movie, emu))
+    {
+        *frames = 0;
+        return 0;
+    }
+
+    const double start = now ();
+    uint32_t frame = 0;
+
+    for (; frame < *frames; frame++)
+    {
+        if (input->isMovie)
+        {
+            if (!movie_play_frame (&input->movie, emu)) break;
+        }
+        else if (input->count)
+        {
+            const uint32_t i = (frame < input->count) ? frame : input->count - 1;
+            nesemu_set_input (emu, 0, input->buttons[i][0]);
+            nesemu_set_input (emu, 1, input->buttons[i][1]);
+        }
+        if (record)
+            movie_record_frame (record, emu);
+
+        nesemu_run_frame (emu);
+
+        if (hashes)
+            printf ("hash %u %016llx\n", frame, (unsigned long long)frame_hash (emu));
+    }
+
+    *frames = frame;
+    return now () - start;
+}
+
+/* Batch jobs */
+
+typedef struct Job_struct
+{
+    char * rom;
+    char * input;
+    uint32_t frames; /* 0 to use the default */
+    uint64_t expected;
+    uint8_t  hasExpected;
+
+    /* Results */
+    uint32_t framesRun;
+    uint64_t hash;
+    double   seconds;
+    uint8_t  loaded;
+}
+Job;
+
+typedef struct Batch_struct
+{
+    Job * jobs;
+    uint32_t count, next;
+    uint32_t frames;
+    pthread_mutex_t lock;
+}
+Batch;
+
+static void job_run (Job * const job, uint32_t const frames)
+{
+    Input input = { 0 };
+    NESemu * emu = nesemu_create ();
+
+    job->loaded = emu && nesemu_load_file (emu, job->rom) &&
+        (!job->input || input_load (&input, job->input));
+
+    if (job->loaded)
+    {
+        job->framesRun = job->frames ? job->frames : input_frames (&input, frames);
+        job->seconds = run_frames (emu, &input, &job->framesRun, 0, NULL);
+
+        /* A movie made with another ROM */
+        if (!job->framesRun && input.isMovie)
+            job->loaded = 0;
+        else
+            job->hash = frame_hash (emu);
+    }
+
+    nesemu_destroy (emu);
+    input_free (&input);
+}
+
+static void * batch_worker (void * arg)
+{
+    Batch * const batch = arg;
+
+    for (;;)
+    {
+        pthread_mutex_lock (&batch->lock);
+        const uint32_t i = batch->next++;
+        pthread_mutex_unlock (&batch->lock);
+
+        if (i >= batch->count) break;
+        job_run (&batch->jobs[i], batch->frames);
+    }
+    return NULL;
+}
+
+/* Run all jobs on a number of threads, returns the wall time taken */
+
+static double batch_run (Batch * const batch, uint32_t const threads)
+{
+    pthread_t * const workers = malloc (threads * sizeof(pthread_t));
+    uint32_t started = 0;
+
+    batch->next = 0;
+    const double start = now ();
+
+    for (; started < threads; started++)
+    {
+        if (pthread_create (&workers[started], NULL, batch_worker, batch)) break;
+    }
+
+    /* Without any worker, run the jobs on this thread */
+    if (!started) batch_worker (batch);
+
+    for (uint32_t i = 0; i < started; i++)
+        pthread_join (workers[i], NULL);
+
+    free (workers);
+    return now () - start;
+}
+
+static uint8_t batch_load (Batch * const batch, const char * const path)
+{
+    FILE * f = fopen (path, "r");
+    if (!f) return 0;
+
+    uint32_t capacity = 0;
+    char line[1024];
+
+    while (fgets (line, sizeof(line), f))
+    {
+        char rom[512], input[512] = "-", jobFrames[32] = "-";
+        unsigned long long expected = 0;
+
+        if (line[0] == '#') continue;
+        const int fields = sscanf (line, "%511s %511s %31s %llx", rom, input, jobFrames, &expected);
+        if (fields < 1) continue;
+
+        if (batch->count == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 64;
+            batch->jobs = realloc (batch->jobs, capacity * sizeof(Job));
+        }
+
+        Job * const job = &batch->jobs[batch->count++];
+        *job = (Job){ 0 };
+        job->rom         = strdup (rom);
+        job->input       = strcmp (input, "-") ? strdup (input) : NULL;
+        job->frames      = strtoul (jobFrames, NULL, 0);
+        job->expected    = expected;
+        job->hasExpected = (fields >= 4);
+    }
+
+    fclose (f);
+    return 1;
+}
+
+static uint64_t batch_frames (Batch * const batch)
+{
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < batch->count; i++)
+        total += batch->jobs[i].framesRun;
+
+    return total;
+}
+
+static int batch_main (const char * const path, uint32_t const frames, uint32_t threads, uint8_t const scaling)
+{
+    Batch batch = { .frames = frames };
+    if (!batch_load (&batch, path))
+    {
+        fprintf (stderr, "Cannot read manifest '%s'\n", path);
+        return EXIT_FAILURE;
+    }
+    pthread_mutex_init (&batch.lock, NULL);
+
+    if (!threads)
+    {
+        const long cores = sysconf (_SC_NPROCESSORS_ONLN);
+        threads = (cores > 0) ? cores : 1;
+    }
+
+    /* Scaling report, the full batch at each thread count */
+    if (scaling)
+    {
+        double single = 0;
+        printf ("threads   wall s      fps  speedup  efficiency\n");
+
+        for (uint32_t n = 1; ; n = (n * 2 < threads) ? n * 2 : threads)
+        {
+            const double wall = batch_run (&batch, n);
+            if (n == 1) single = wall;
+
+            const uint64_t totalFrames = batch_frames (&batch);
+            printf ("%7u %8.3f %8.1f %8.2f %10.0f%%\n", n, wall, totalFrames / wall,
+                single / wall, 100.0 * single / (wall * n));
+            if (n == threads) break;
+        }
+    }
+
+    const double wall = batch_run (&batch, threads);
+    const uint64_t totalFrames = batch_frames (&batch);
+    uint32_t passed = 0, failed = 0, errors = 0;
+
+    printf ("job  result  wall ms      fps  hash              rom\n");
+    for (uint32_t i = 0; i < batch.count; i++)
+    {
+        Job * const job = &batch.jobs[i];
+        const char * result = "-";
+
+        if (!job->loaded)
+        {
+            result = "ERROR";
+            errors++;
+        }
+        else if (job->hasExpected)
+        {
+            result = (job->hash == job->expected) ? "PASS" : "FAIL";
+            if (job->hash == job->expected) passed++; else failed++;
+        }
+
+        printf ("%3u  %-6s %8.1f %8.1f  %016llx  %s\n", i, result, job->seconds * 1000,
+            job->seconds > 0 ? job->framesRun / job->seconds : 0, (unsigned long long)job->hash, job->rom);
+
+        free (job->rom);
+        free (job->input);
+    }
+
+    printf ("%u jobs on %u threads, %.3f s, %.1f fps total, %u passed, %u failed, %u errors\n",
+        batch.count, threads, wall, wall > 0 ? totalFrames / wall : 0, passed, failed, errors);
+
+    pthread_mutex_destroy (&batch.lock);
+    free (batch.jobs);
+    return (failed || errors) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int main (int argc, char** argv)
+{
+    const char * romPath = NULL;
+    const char * inputPath = NULL;
+    const char * ppmPath = NULL;
+    const char * batchPath = NULL;
+    const char * recordPath = NULL;
+    uint32_t frames = 0;
+    uint32_t seed = 0;
+    uint32_t threads = 0;
+    uint8_t  hashes = 0;
+    uint8_t  scaling = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if      (!strcmp (argv[i], "-frames") && i + 1 < argc) frames = strtoul (argv[++i], NULL, 0);
+        else if (!strcmp (argv[i], "-input")  && i + 1 < argc) inputPath = argv[++i];
+        else if (!strcmp (argv[i], "-ppm")    && i + 1 < argc) ppmPath = argv[++i];
+        else if (!strcmp (argv[i], "-batch")  && i + 1 < argc) batchPath = argv[++i];
+        else if (!strcmp (argv[i], "-threads") && i + 1 < argc) threads = strtoul (argv[++i], NULL, 0);
+        else if (!strcmp (argv[i], "-record") && i + 1 < argc) recordPath = argv[++i];
+        else if (!strcmp (argv[i], "-seed")   && i + 1 < argc) seed = strtoul (argv[++i], NULL, 0);
+        else if (!strcmp (argv[i], "-hashes")) hashes = 1;
+        else if (!strcmp (argv[i], "-scaling")) scaling = 1;
+        else if (argv[i][0] != '-' && !romPath) romPath = argv[i];
+        else
+        {
+            fprintf (stderr, "Unknown option '%s'\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (batchPath)
+        return batch_main (batchPath, frames ? frames : DEFAULT_FRAMES, threads, scaling);
+
+    if (!romPath)
+    {
+        fprintf (stderr, "Usage: %s rom.nes [-frames N] [-input file] [-ppm out.ppm] [-hashes] [-record movie] [-seed N]\n", argv[0]);
+        fprintf (stderr, "       %s -batch manifest [-frames N] [-threads N] [-scaling]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    Input input = { 0 };
+    if (inputPath && !input_load (&input, inputPath))
+    {
+        fprintf (stderr, "Cannot read input file '%s'\n", inputPath);
+        return EXIT_FAILURE;
+    }
+
+    NESemu * emu = nesemu_create ();
+    if (!emu || !nesemu_load_file (emu, romPath))
+    {
+        fprintf (stderr, "Cannot load ROM '%s'\n", romPath);
+        return EXIT_FAILURE;
+    }
+
+    /* Recording and seeding start from power on, movies bring their own seed */
+    Movie record = { 0 };
+    if (recordPath)
+    {
+        if (input.isMovie)
+        {
+            fprintf (stderr, "Only text input can be recorded to a movie\n");
+            return EXIT_FAILURE;
+        }
+        movie_record_start (&record, emu, seed);
+    }
+    else if (seed && !input.isMovie)
+        nesemu_power_on (emu, seed);
+
+    if (!frames)
+        frames = input_frames (&input, DEFAULT_FRAMES);
+
+    const double elapsed = run_frames (emu, &input, &frames, hashes, recordPath ? &record : NULL);
+    if (input.isMovie && !frames)
+    {
+        fprintf (stderr, "Movie '%s' was made with a different ROM\n", inputPath);
+        return EXIT_FAILURE;
+    }
+
+    printf ("fps %.1f (%u frames in %.3f s)\n", elapsed > 0 ? frames / elapsed : 0, frames, elapsed);
+
+    int status = EXIT_SUCCESS;
+    if (ppmPath && !write_ppm (emu, ppmPath))
+    {
+        fprintf (stderr, "Cannot write '%s'\n", ppmPath);
+        status = EXIT_FAILURE;
+    }
+    if (recordPath && !movie_save (&record, recordPath))
+    {
+        fprintf (stderr, "Cannot write '%s'\n", recordPath);
+        status = EXIT_FAILURE;
+    }
+
+    nesemu_destroy (emu);
+    input_free (&input);
+    movie_free (&record);
+    return status;
+}
@@ -0,0 +1,61 @@
+#include <stdio.h>
+#include <stddef.h>
+#include "../src/bus.h"
+
+/* Struct layout report. Prints the size of the emulator state and where the
+   fields used every cycle land relative to 64 byte cache lines */
+
+#define FIELD(type, member) \
+    report (#type "." #member, offsetof(type, member), sizeof(((type*)0)->member))
+
+static void report (const char * name, size_t const offset, size_t const size)
+{
+    printf("  %-28s %7zu %7zu   line %zu-%zu\n", name, offset, size,
+        offset / 64, (offset + size - 1) / 64);
+}
+
+int main (void)
+{
+    printf("Bus       %zu bytes\n", sizeof(Bus));
+    printf("CPU6502   %zu bytes\n", sizeof(CPU6502));
+    printf("PPU2C02   %zu bytes\n", sizeof(PPU2C02));
+    printf("NESrom    %zu bytes\n", sizeof(NESrom));
+    printf("PPUDebug  %zu bytes (allocated on demand)\n\n", sizeof(PPUDebug));
+
+    printf("  %-28s %7s %7s\n", "field", "offset", "size");
+    FIELD (Bus, clockCount);
+    FIELD (Bus, cpu);
+    FIELD (Bus, controller);
+    FIELD (Bus, readMap);
+    FIELD (Bus, writeMap);
+    FIELD (Bus, ram);
+    FIELD (Bus, ppu);
+    FIELD (Bus, rom);
+    printf("\n");
+
+    FIELD (CPU6502, r);
+    FIELD (CPU6502, opcode);
+    FIELD (CPU6502, clockticks);
+    FIELD (CPU6502, abs_addr);
+    FIELD (CPU6502, clockCount);
+    FIELD (CPU6502, clockGoal);
+    FIELD (CPU6502, status);
+    FIELD (CPU6502, lastop);
+    printf("\n");
+
+    FIELD (PPU2C02, cycle);
+    FIELD (PPU2C02, scanline);
+    FIELD (PPU2C02, VRam);
+    FIELD (PPU2C02, control);
+    FIELD (PPU2C02, clockCount);
+    FIELD (PPU2C02, eventClock);
+    FIELD (PPU2C02, mapper);
+    FIELD (PPU2C02, nameTablePage);
+    FIELD (PPU2C02, paletteTable);
+    FIELD (PPU2C02, nameTables);
+    FIELD (PPU2C02, OAMdata);
+    FIELD (PPU2C02, tileCache);
+    FIELD (PPU2C02, frameBuffer);
+
+    return 0;
+}
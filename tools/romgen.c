@@ -0,0 +1,383 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+/* Synthetic stress ROMs for the benchmark. Each one is a small hand assembled
+   program that leans on one part of the core:
+
+   scroll.nes     $2005 writes in a tight loop while rendering, plus a scroll
+                  change every frame
+   sprites.nes    64 8x16 sprites packed into 16 lines, moved and copied with
+                  OAM DMA every frame
+   chrram.nes     UxROM with CHR RAM, switches PRG bank and copies 512 bytes
+                  to the pattern tables every frame
+   poll2002.nes   no NMI, waits for vertical blank by polling $2002
+
+   ne-semu-romgen outdir
+
+   The programs never read the controllers, so every run is the same */
+
+#define PRG_BANK 0x4000
+#define CHR_SIZE 0x2000
+
+/* 6502 opcodes used below */
+
+enum Opcode
+{
+    ADC_IMM = 0x69, AND_IMM = 0x29, ASL_ACC = 0x0a, BIT_ABS = 0x2c,
+    BNE     = 0xd0, BPL     = 0x10, CLC     = 0x18, CLD     = 0xd8,
+    CPX_IMM = 0xe0, DEX     = 0xca, DEY     = 0x88, INC_ABX = 0xfe,
+    INC_ZP  = 0xe6, INX     = 0xe8, INY     = 0xc8, JMP_ABS = 0x4c,
+    LDA_ABY = 0xb9, LDA_IMM = 0xa9, LDA_IZY = 0xb1, LDA_ZP  = 0xa5,
+    LDX_IMM = 0xa2, LDY_IMM = 0xa0, LSR_ACC = 0x4a, ORA_IMM = 0x09,
+    PHA     = 0x48, PLA     = 0x68, RTI     = 0x40, SEI     = 0x78,
+    STA_ABS = 0x8d, STA_ABX = 0x9d, STA_ABY = 0x99, STA_ZP  = 0x85,
+    STX_ABS = 0x8e, TAX     = 0xaa, TAY     = 0xa8, TXA     = 0x8a,
+    TXS     = 0x9a, TYA     = 0x98
+};
+
+/* Assembles into the last PRG bank, which sits at $c000 for both mappers used */
+
+typedef struct Asm_struct
+{
+    uint8_t * bank;
+    uint16_t  pc;
+}
+Asm;
+
+static void op1 (Asm * const a, uint8_t const op)
+{
+    a->bank[a->pc++ - 0xc000] = op;
+}
+
+static void op2 (Asm * const a, uint8_t const op, uint8_t const value)
+{
+    op1 (a, op);
+    op1 (a, value);
+}
+
+static void op3 (Asm * const a, uint8_t const op, uint16_t const address)
+{
+    op1 (a, op);
+    op1 (a, address & 0xff);
+    op1 (a, address >> 8);
+}
+
+/* Backward branch to a label taken from a->pc */
+
+static void branch (Asm * const a, uint8_t const op, uint16_t const target)
+{
+    op2 (a, op, (uint8_t)(target - (a->pc + 2)));
+}
+
+static void lda_sta (Asm * const a, uint8_t const value, uint16_t const address)
+{
+    op2 (a, LDA_IMM, value);
+    op3 (a, STA_ABS, address);
+}
+
+static void vectors (Asm * const a, uint16_t const nmi, uint16_t const reset)
+{
+    a->pc = 0xfffa;
+    op1 (a, nmi & 0xff);   op1 (a, nmi >> 8);
+    op1 (a, reset & 0xff); op1 (a, reset >> 8);
+    op1 (a, reset & 0xff); op1 (a, reset >> 8);
+}
+
+/* Power up wait, then palette and nametables with rendering off. Leaves the
+   code position for the program's own setup */
+
+static void emit_init (Asm * const a)
+{
+    op1 (a, SEI);
+    op1 (a, CLD);
+    op2 (a, LDX_IMM, 0xff);
+    op1 (a, TXS);
+    lda_sta (a, 0, 0x2000);
+    lda_sta (a, 0, 0x2001);
+
+    for (int i = 0; i < 2; i++)
+    {
+        const uint16_t wait = a->pc;
+        op3 (a, BIT_ABS, 0x2002);
+        branch (a, BPL, wait);
+    }
+
+    /* Palette entries 0-31 */
+    lda_sta (a, 0x3f, 0x2006);
+    lda_sta (a, 0x00, 0x2006);
+    op2 (a, LDX_IMM, 0);
+    uint16_t loop = a->pc;
+    op3 (a, STX_ABS, 0x2007);
+    op1 (a, INX);
+    op2 (a, CPX_IMM, 32);
+    branch (a, BNE, loop);
+
+    /* Both nametables, tile numbers counting up */
+    lda_sta (a, 0x20, 0x2006);
+    lda_sta (a, 0x00, 0x2006);
+    op2 (a, LDY_IMM, 8);
+    op2 (a, LDX_IMM, 0);
+    loop = a->pc;
+    op3 (a, STX_ABS, 0x2007);
+    op1 (a, INX);
+    branch (a, BNE, loop);
+    op1 (a, DEY);
+    branch (a, BNE, loop);
+
+    lda_sta (a, 0, 0x2005);
+    lda_sta (a, 0, 0x2005);
+}
+
+/* Fill with xorshift output so tiles and copied data are never flat */
+
+static void fill_random (uint8_t * const data, size_t const size, uint32_t seed)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        data[i] = seed;
+    }
+}
+
+static uint8_t write_rom (const char * const dir, const char * const name, uint8_t const mapper,
+    const uint8_t * const prg, uint8_t const prgBanks, const uint8_t * const chr)
+{
+    char path[1024];
+    snprintf (path, sizeof(path), "%s/%s", dir, name);
+
+    FILE * f = fopen (path, "wb");
+    if (!f)
+    {
+        fprintf (stderr, "Cannot write '%s'\n", path);
+        return 0;
+    }
+
+    /* Vertical mirroring, one 8KB CHR ROM bank unless it uses CHR RAM */
+    const uint8_t header[16] = { 'N', 'E', 'S', 0x1a, prgBanks, chr ? 1 : 0,
+        (uint8_t)((mapper << 4) | 1), (uint8_t)(mapper & 0xf0) };
+
+    uint8_t written =
+        fwrite (header, 1, sizeof(header), f) == sizeof(header) &&
+        fwrite (prg, 1, prgBanks * PRG_BANK, f) == (size_t)prgBanks * PRG_BANK;
+    if (chr)
+        written = written && fwrite (chr, 1, CHR_SIZE, f) == CHR_SIZE;
+
+    written = (fclose (f) == 0) && written;
+    if (written)
+        printf ("%s\n", path);
+
+    return written;
+}
+
+/* Workloads */
+
+static void gen_scroll (uint8_t * const bank)
+{
+    Asm a = { bank, 0xc000 };
+    emit_init (&a);
+    lda_sta (&a, 0x80, 0x2000);
+    lda_sta (&a, 0x1e, 0x2001);
+
+    /* Raster scroll writes, each one brings the PPU up to date */
+    const uint16_t main = a.pc;
+    op2 (&a, LDX_IMM, 0);
+    const uint16_t loop = a.pc;
+    op3 (&a, STX_ABS, 0x2005);
+    op3 (&a, STX_ABS, 0x2005);
+    op1 (&a, INX);
+    branch (&a, BNE, loop);
+    op3 (&a, JMP_ABS, main);
+
+    /* NMI: scroll diagonally, alternate nametables */
+    const uint16_t nmi = a.pc;
+    op1 (&a, PHA);
+    op2 (&a, INC_ZP, 0x10);
+    op2 (&a, LDA_ZP, 0x10);
+    op3 (&a, STA_ABS, 0x2005);
+    op3 (&a, STA_ABS, 0x2005);
+    op2 (&a, AND_IMM, 0x01);
+    op2 (&a, ORA_IMM, 0x80);
+    op3 (&a, STA_ABS, 0x2000);
+    op1 (&a, PLA);
+    op1 (&a, RTI);
+
+    vectors (&a, nmi, 0xc000);
+}
+
+static void gen_sprites (uint8_t * const bank)
+{
+    Asm a = { bank, 0xc000 };
+    emit_init (&a);
+
+    /* Sprite n at line $40 + (n & 15) * 4, so every line has more than 8 */
+    op2 (&a, LDX_IMM, 0);
+    const uint16_t fill = a.pc;
+    op1 (&a, TXA);
+    op2 (&a, AND_IMM, 0x3f);
+    op1 (&a, CLC);
+    op2 (&a, ADC_IMM, 0x40);
+    op3 (&a, STA_ABX, 0x0200);
+    op1 (&a, TXA);
+    op3 (&a, STA_ABX, 0x0201);
+    op1 (&a, LSR_ACC);
+    op1 (&a, LSR_ACC);
+    op2 (&a, AND_IMM, 0xe3);
+    op3 (&a, STA_ABX, 0x0202);
+    op1 (&a, TXA);
+    op3 (&a, STA_ABX, 0x0203);
+    op1 (&a, INX); op1 (&a, INX); op1 (&a, INX); op1 (&a, INX);
+    branch (&a, BNE, fill);
+
+    lda_sta (&a, 0xa0, 0x2000);
+    lda_sta (&a, 0x1e, 0x2001);
+    const uint16_t idle = a.pc;
+    op3 (&a, JMP_ABS, idle);
+
+    /* NMI: move every sprite right, then DMA the page */
+    const uint16_t nmi = a.pc;
+    op1 (&a, PHA);
+    op1 (&a, TXA);
+    op1 (&a, PHA);
+    op2 (&a, LDX_IMM, 0);
+    const uint16_t move = a.pc;
+    op3 (&a, INC_ABX, 0x0203);
+    op1 (&a, INX); op1 (&a, INX); op1 (&a, INX); op1 (&a, INX);
+    branch (&a, BNE, move);
+    lda_sta (&a, 0x00, 0x2003);
+    lda_sta (&a, 0x02, 0x4014);
+    op1 (&a, PLA);
+    op1 (&a, TAX);
+    op1 (&a, PLA);
+    op1 (&a, RTI);
+
+    vectors (&a, nmi, 0xc000);
+}
+
+static void gen_chrram (uint8_t * const bank)
+{
+    Asm a = { bank, 0xc000 };
+    emit_init (&a);
+
+    /* Copy source pointer at $00 */
+    op2 (&a, LDA_IMM, 0x00);
+    op2 (&a, STA_ZP, 0x00);
+    op2 (&a, LDA_IMM, 0x80);
+    op2 (&a, STA_ZP, 0x01);
+
+    lda_sta (&a, 0x80, 0x2000);
+    lda_sta (&a, 0x0a, 0x2001);
+    const uint16_t idle = a.pc;
+    op3 (&a, JMP_ABS, idle);
+
+    /* Bank numbers, written over themselves to avoid bus conflicts */
+    const uint16_t banks = a.pc;
+    for (uint8_t i = 0; i < 4; i++) op1 (&a, i);
+
+    /* NMI: rendering off, next PRG bank, copy 512 bytes of it into CHR RAM */
+    const uint16_t nmi = a.pc;
+    op1 (&a, PHA);
+    op1 (&a, TXA);
+    op1 (&a, PHA);
+    op1 (&a, TYA);
+    op1 (&a, PHA);
+    lda_sta (&a, 0x00, 0x2001);
+
+    op2 (&a, INC_ZP, 0x10);
+    op2 (&a, LDA_ZP, 0x10);
+    op2 (&a, AND_IMM, 0x03);
+    op1 (&a, TAY);
+    op3 (&a, LDA_ABY, banks);
+    op3 (&a, STA_ABY, banks);
+
+    op2 (&a, LDA_ZP, 0x10);
+    op1 (&a, ASL_ACC);
+    op2 (&a, AND_IMM, 0x1e);
+    op3 (&a, STA_ABS, 0x2006);
+    lda_sta (&a, 0x00, 0x2006);
+
+    op2 (&a, LDX_IMM, 2);
+    op2 (&a, LDY_IMM, 0);
+    const uint16_t copy = a.pc;
+    op2 (&a, LDA_IZY, 0x00);
+    op3 (&a, STA_ABS, 0x2007);
+    op1 (&a, INY);
+    branch (&a, BNE, copy);
+    op2 (&a, INC_ZP, 0x01);
+    op1 (&a, DEX);
+    branch (&a, BNE, copy);
+    op2 (&a, LDA_IMM, 0x80);
+    op2 (&a, STA_ZP, 0x01);
+
+    /* $2006 writes moved the scroll, put it back */
+    lda_sta (&a, 0x00, 0x2005);
+    lda_sta (&a, 0x00, 0x2005);
+    lda_sta (&a, 0x80, 0x2000);
+    lda_sta (&a, 0x0a, 0x2001);
+    op1 (&a, PLA);
+    op1 (&a, TAY);
+    op1 (&a, PLA);
+    op1 (&a, TAX);
+    op1 (&a, PLA);
+    op1 (&a, RTI);
+
+    vectors (&a, nmi, 0xc000);
+}
+
+static void gen_poll2002 (uint8_t * const bank)
+{
+    Asm a = { bank, 0xc000 };
+    emit_init (&a);
+    lda_sta (&a, 0x00, 0x2000);
+    lda_sta (&a, 0x1e, 0x2001);
+
+    /* Wait for vertical blank, then scroll one pixel */
+    const uint16_t main = a.pc;
+    op3 (&a, BIT_ABS, 0x2002);
+    branch (&a, BPL, main);
+    op2 (&a, INC_ZP, 0x10);
+    op2 (&a, LDA_ZP, 0x10);
+    op3 (&a, STA_ABS, 0x2005);
+    op3 (&a, STA_ABS, 0x2005);
+    op3 (&a, JMP_ABS, main);
+
+    vectors (&a, 0xc000, 0xc000);
+}
+
+int main (int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        fprintf (stderr, "Usage: %s outdir\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    const char * const dir = argv[1];
+
+    static uint8_t prg[4 * PRG_BANK], chr[CHR_SIZE];
+    fill_random (chr, sizeof(chr), 0x2c02);
+    uint8_t ok = 1;
+
+    /* NROM-128, the program fills the only bank */
+    memset (prg, 0, PRG_BANK);
+    gen_scroll (prg);
+    ok &= write_rom (dir, "scroll.nes", 0, prg, 1, chr);
+
+    memset (prg, 0, PRG_BANK);
+    gen_sprites (prg);
+    ok &= write_rom (dir, "sprites.nes", 0, prg, 1, chr);
+
+    memset (prg, 0, PRG_BANK);
+    gen_poll2002 (prg);
+    ok &= write_rom (dir, "poll2002.nes", 0, prg, 1, chr);
+
+    /* UxROM with four banks of data to copy, code in the fixed last bank */
+    fill_random (prg, sizeof(prg), 0x6502);
+    memset (prg + 3 * PRG_BANK, 0, PRG_BANK);
+    gen_chrram (prg + 3 * PRG_BANK);
+    ok &= write_rom (dir, "chrram.nes", 2, prg, 4, NULL);
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}